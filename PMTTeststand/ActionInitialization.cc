@@ -4,6 +4,7 @@
 #include "EventAction.hh"
 #include "RunAction.hh"
 #include "SteppingAction.hh"
+#include "TrackingAction.hh"
 
 ActionInitialization::ActionInitialization(std::string outputName)
     : fOutputName(outputName) {}
@@ -23,12 +24,15 @@ void ActionInitialization::Build() const {
   EventAction *theEventAction = new EventAction(theRunAction);
   SetUserAction(theEventAction);
   SetUserAction(new SteppingAction(theRunAction, theEventAction));
+  SetUserAction(new TrackingAction(theRunAction));
 }
 
 //==============================================================================
 
 void ActionInitialization::BuildForMaster() const {
-  // Only relevant in MT mode. MT COMPATIBILITY NOT TESTED
+  // Only used in MT and tasking mode. The master run action opens the output
+  // file the worker output gets merged into and closes it once all workers
+  // have finished the run
   SetUserAction(new RunAction(fOutputName));
 }
 
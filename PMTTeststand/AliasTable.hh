@@ -0,0 +1,66 @@
+#ifndef ALIAS_TABLE_HH
+#define ALIAS_TABLE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Walker's alias method, built with Vose's algorithm. After an O(n) setup,
+// an index of a discrete distribution is drawn in O(1) from one uniform
+// random number, independent of the number of bins
+class AliasTable {
+public:
+  //! Weights do not have to be normalised
+  void Build(const std::vector<double> &weights) {
+    const std::size_t n = weights.size();
+    fProbability.assign(n, 1.);
+    fAlias.resize(n);
+    double sum = 0.;
+    for (const auto weight : weights)
+      sum += weight;
+    if (n == 0 || sum <= 0.)
+      return;
+
+    // Scaled so that the mean is 1, bins below take their rest from a bin
+    // above
+    std::vector<double> scaled(n);
+    std::vector<std::uint32_t> small, large;
+    for (std::size_t i = 0; i < n; ++i) {
+      scaled[i] = weights[i] * n / sum;
+      fAlias[i] = i;
+      (scaled[i] < 1. ? small : large).push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+      const auto less = small.back();
+      const auto more = large.back();
+      small.pop_back();
+      fProbability[less] = scaled[less];
+      fAlias[less] = more;
+      scaled[more] -= 1. - scaled[less];
+      if (scaled[more] < 1.) {
+        large.pop_back();
+        small.push_back(more);
+      }
+    }
+    // The remaining bins are full up to rounding
+    for (const auto i : small)
+      fProbability[i] = 1.;
+  }
+
+  //! u uniform in [0, 1)
+  std::size_t Sample(double u) const {
+    const double x = u * fProbability.size();
+    std::size_t i = static_cast<std::size_t>(x);
+    if (i >= fProbability.size())
+      i = fProbability.size() - 1;
+    return x - i < fProbability[i] ? i : fAlias[i];
+  }
+
+  std::size_t Size() const { return fProbability.size(); }
+
+private:
+  std::vector<double> fProbability; // of keeping the bin instead of its alias
+  std::vector<std::uint32_t> fAlias;
+};
+
+#endif
@@ -0,0 +1,243 @@
+#include "ColumnarFile.hh"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef SANDBOX_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "globals.hh"
+
+using namespace ColumnarFormat;
+
+namespace {
+
+// Bounds checked reading of the footer
+class FooterReader {
+public:
+  FooterReader(const char *data, std::size_t size) : fData(data), fSize(size) {}
+
+  bool Good() const { return fGood; }
+
+  template <typename T> T Get() {
+    T value{};
+    if (fPos + sizeof(T) > fSize) {
+      fGood = false;
+      return value;
+    }
+    std::memcpy(&value, fData + fPos, sizeof(T));
+    fPos += sizeof(T);
+    return value;
+  }
+
+  std::string GetString() {
+    auto length = Get<std::uint32_t>();
+    if (!fGood || fPos + length > fSize) {
+      fGood = false;
+      return {};
+    }
+    std::string value(fData + fPos, length);
+    fPos += length;
+    return value;
+  }
+
+private:
+  const char *fData;
+  std::size_t fSize;
+  std::size_t fPos = 0;
+  bool fGood = true;
+};
+
+} // namespace
+
+//==============================================================================
+
+ColumnarFile::~ColumnarFile() { Close(); }
+
+//==============================================================================
+
+bool ColumnarFile::Open(const std::string &fileName) {
+  Close();
+  int fd = ::open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) {
+    G4cerr << "Error: Could not open " << fileName << G4endl;
+    return false;
+  }
+  struct stat info;
+  if (::fstat(fd, &info) != 0 || info.st_size < 32) {
+    G4cerr << "Error: " << fileName << " is not a columnar file" << G4endl;
+    ::close(fd);
+    return false;
+  }
+  fSize = info.st_size;
+  void *data = ::mmap(nullptr, fSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    G4cerr << "Error: Could not map " << fileName << G4endl;
+    fSize = 0;
+    return false;
+  }
+  fData = static_cast<const char *>(data);
+
+  if (!ParseFooter()) {
+    G4cerr << "Error: " << fileName << " is not a valid columnar file"
+           << G4endl;
+    Close();
+    return false;
+  }
+  return true;
+}
+
+//==============================================================================
+
+void ColumnarFile::Close() {
+  if (fData)
+    ::munmap(const_cast<char *>(fData), fSize);
+  fData = nullptr;
+  fSize = 0;
+  fTables.clear();
+}
+
+//==============================================================================
+
+bool ColumnarFile::ParseFooter() {
+  if (std::memcmp(fData, kMagic, sizeof(kMagic)) != 0 ||
+      std::memcmp(fData + fSize - sizeof(kEndMagic), kEndMagic,
+                  sizeof(kEndMagic)) != 0)
+    return false;
+  std::uint64_t footerOffset;
+  std::memcpy(&footerOffset, fData + fSize - sizeof(kEndMagic) - 8, 8);
+  std::uint64_t footerEnd = fSize - sizeof(kEndMagic) - 8;
+  if (footerOffset >= footerEnd)
+    return false;
+
+  FooterReader footer(fData + footerOffset, footerEnd - footerOffset);
+  auto nofTables = footer.Get<std::uint32_t>();
+  for (std::uint32_t t = 0; t < nofTables && footer.Good(); ++t) {
+    TableDesc table;
+    table.name = footer.GetString();
+    table.nofRows = footer.Get<std::uint64_t>();
+    auto nofColumns = footer.Get<std::uint32_t>();
+    for (std::uint32_t c = 0; c < nofColumns && footer.Good(); ++c) {
+      ColumnDesc column;
+      column.name = footer.GetString();
+      column.type = static_cast<ColumnType>(footer.Get<std::uint8_t>());
+      if (footer.Good() && SizeOf(column.type) == 0)
+        return false;
+      table.columns.push_back(column);
+    }
+    // The blocks have to cover the rows of the table without gaps, and every
+    // chunk has to lie before the footer and hold exactly the rows of its
+    // block, so the readers can copy them without further checks
+    std::uint64_t nextRow = 0;
+    auto nofBlocks = footer.Get<std::uint32_t>();
+    for (std::uint32_t b = 0; b < nofBlocks && footer.Good(); ++b) {
+      BlockDesc block;
+      block.firstRow = footer.Get<std::uint64_t>();
+      block.nofRows = footer.Get<std::uint32_t>();
+      if (footer.Good() && block.firstRow != nextRow)
+        return false;
+      nextRow += block.nofRows;
+      for (std::uint32_t c = 0; c < nofColumns && footer.Good(); ++c) {
+        ColumnChunk chunk;
+        chunk.offset = footer.Get<std::uint64_t>();
+        chunk.storedSize = footer.Get<std::uint32_t>();
+        chunk.rawSize = footer.Get<std::uint32_t>();
+        chunk.codec = static_cast<Codec>(footer.Get<std::uint8_t>());
+        if (!footer.Good())
+          break;
+        if (chunk.offset > footerOffset ||
+            chunk.storedSize > footerOffset - chunk.offset ||
+            chunk.rawSize != std::uint64_t{block.nofRows} *
+                                 SizeOf(table.columns[c].type) ||
+            (chunk.codec != Codec::Raw && chunk.codec != Codec::Zstd) ||
+            (chunk.codec == Codec::Raw && chunk.storedSize != chunk.rawSize))
+          return false;
+        block.chunks.push_back(chunk);
+      }
+      table.blocks.push_back(block);
+    }
+    if (footer.Good() && nextRow != table.nofRows)
+      return false;
+    table.indexOffset = footer.Get<std::uint64_t>();
+    table.nofIndexEntries = footer.Get<std::uint64_t>();
+    if (table.indexOffset % 8 != 0 || table.indexOffset > footerOffset ||
+        table.nofIndexEntries >
+            (footerOffset - table.indexOffset) / sizeof(IndexEntry))
+      return false;
+    fTables.push_back(table);
+  }
+  return footer.Good();
+}
+
+//==============================================================================
+
+const TableDesc *ColumnarFile::GetTable(const std::string &name) const {
+  for (const auto &table : fTables) {
+    if (table.name == name)
+      return &table;
+  }
+  return nullptr;
+}
+
+//==============================================================================
+
+int ColumnarFile::GetColumnIndex(const TableDesc &table,
+                                 const std::string &name) const {
+  for (size_t i = 0; i < table.columns.size(); ++i) {
+    if (table.columns[i].name == name)
+      return i;
+  }
+  return -1;
+}
+
+//==============================================================================
+
+bool ColumnarFile::ReadChunk(const TableDesc &table, std::size_t block,
+                             std::size_t column,
+                             std::vector<char> &data) const {
+  const auto &chunk = table.blocks[block].chunks[column];
+  const char *stored = fData + chunk.offset;
+  data.resize(chunk.rawSize);
+  switch (chunk.codec) {
+  case Codec::Raw:
+    std::memcpy(data.data(), stored, chunk.rawSize);
+    return true;
+  case Codec::Zstd:
+#ifdef SANDBOX_WITH_ZSTD
+  {
+    size_t size = ZSTD_decompress(data.data(), data.size(), stored,
+                                  chunk.storedSize);
+    return !ZSTD_isError(size) && size == chunk.rawSize;
+  }
+#else
+    G4cerr << "Error: File is zstd compressed, but zstd support is not built "
+              "in"
+           << G4endl;
+    return false;
+#endif
+  }
+  return false;
+}
+
+//==============================================================================
+
+const IndexEntry *ColumnarFile::FindEvent(const TableDesc &table,
+                                          std::int64_t eventID) const {
+  // The index is sorted by event ID and used directly from the mapped file
+  auto first = reinterpret_cast<const IndexEntry *>(fData + table.indexOffset);
+  auto last = first + table.nofIndexEntries;
+  auto entry = std::lower_bound(first, last, eventID,
+                                [](const IndexEntry &a, std::int64_t id) {
+                                  return a.eventID < id;
+                                });
+  if (entry == last || entry->eventID != eventID)
+    return nullptr;
+  return entry;
+}
+
+//==============================================================================
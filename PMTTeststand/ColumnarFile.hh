@@ -0,0 +1,84 @@
+#ifndef COLUMNAR_FILE_HH
+#define COLUMNAR_FILE_HH
+
+#include <cstring>
+
+#include "ColumnarFormat.hh"
+
+// Read access to .scol files. The file is memory mapped, so only the blocks
+// that are actually read are loaded from disk, and the event index is used
+// in place without parsing
+class ColumnarFile {
+public:
+  ColumnarFile() = default;
+  ~ColumnarFile();
+  ColumnarFile(const ColumnarFile &) = delete;
+  ColumnarFile &operator=(const ColumnarFile &) = delete;
+
+  bool Open(const std::string &fileName);
+  void Close();
+
+  const std::vector<ColumnarFormat::TableDesc> &GetTables() const {
+    return fTables;
+  }
+  const ColumnarFormat::TableDesc *GetTable(const std::string &name) const;
+  int GetColumnIndex(const ColumnarFormat::TableDesc &table,
+                     const std::string &name) const;
+
+  //! Decompressed content of one column of one block
+  bool ReadChunk(const ColumnarFormat::TableDesc &table, std::size_t block,
+                 std::size_t column, std::vector<char> &data) const;
+
+  //! Rows of the given event, nullptr if the event has no rows in the table
+  const ColumnarFormat::IndexEntry *
+  FindEvent(const ColumnarFormat::TableDesc &table, std::int64_t eventID) const;
+
+  //! Values of one column for the rows [firstRow, firstRow + nofRows)
+  template <typename T>
+  bool ReadColumn(const ColumnarFormat::TableDesc &table, std::size_t column,
+                  std::uint64_t firstRow, std::uint64_t nofRows,
+                  std::vector<T> &values) const;
+
+private:
+  bool ParseFooter();
+
+  const char *fData = nullptr;
+  std::size_t fSize = 0;
+  std::vector<ColumnarFormat::TableDesc> fTables;
+};
+
+//==============================================================================
+
+template <typename T>
+bool ColumnarFile::ReadColumn(const ColumnarFormat::TableDesc &table,
+                              std::size_t column, std::uint64_t firstRow,
+                              std::uint64_t nofRows,
+                              std::vector<T> &values) const {
+  if (ColumnarFormat::SizeOf(table.columns[column].type) != sizeof(T))
+    return false;
+  // The footer is checked to describe contiguous blocks of table.nofRows
+  // rows, but the requested range may come from a corrupt event index
+  if (firstRow > table.nofRows || nofRows > table.nofRows - firstRow)
+    return false;
+  values.resize(nofRows);
+  std::vector<char> chunk;
+  std::uint64_t row = firstRow;
+  std::uint64_t lastRow = firstRow + nofRows;
+  for (std::size_t i = 0; i < table.blocks.size() && row < lastRow; ++i) {
+    const auto &block = table.blocks[i];
+    std::uint64_t blockEnd = block.firstRow + block.nofRows;
+    if (blockEnd <= row)
+      continue;
+    if (!ReadChunk(table, i, column, chunk) ||
+        chunk.size() != std::uint64_t{block.nofRows} * sizeof(T))
+      return false;
+    std::uint64_t n = std::min(blockEnd, lastRow) - row;
+    std::memcpy(values.data() + (row - firstRow),
+                chunk.data() + (row - block.firstRow) * sizeof(T),
+                n * sizeof(T));
+    row += n;
+  }
+  return row == lastRow;
+}
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef COLUMNAR_FORMAT_HH
+#define COLUMNAR_FORMAT_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Native columnar output format (.scol). Layout, all integers little endian:
+//
+//   "SBCOL001"       8 byte magic
+//   column blocks    every column of a table is stored in blocks of a fixed
+//                    number of rows, each block compressed on its own
+//   event indices    per table a list of {eventID, firstRow, nofRows},
+//                    sorted by eventID, 8 byte aligned for direct mmap access
+//   footer           table, column and block descriptors (see
+//                    ColumnarHitSink::WriteFooter)
+//   uint64           offset of the footer
+//   "SBCOLEND"       8 byte magic
+namespace ColumnarFormat {
+
+// Integers and floats are written and read with memcpy in the byte order of
+// the host, which is only the file layout on little endian hosts
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The .scol format is only supported on little endian hosts"
+#endif
+
+constexpr char kMagic[8] = {'S', 'B', 'C', 'O', 'L', '0', '0', '1'};
+constexpr char kEndMagic[8] = {'S', 'B', 'C', 'O', 'L', 'E', 'N', 'D'};
+
+enum class ColumnType : std::uint8_t {
+  Int32 = 0,
+  Float64 = 1,
+  Float32 = 2,
+  Int64 = 3
+};
+
+enum class Codec : std::uint8_t { Raw = 0, Zstd = 1 };
+
+inline std::size_t SizeOf(ColumnType type) {
+  switch (type) {
+  case ColumnType::Int32:
+  case ColumnType::Float32:
+    return 4;
+  case ColumnType::Float64:
+  case ColumnType::Int64:
+    return 8;
+  }
+  return 0;
+}
+
+struct ColumnDesc {
+  std::string name;
+  ColumnType type;
+};
+
+// Position of one column of one block in the file
+struct ColumnChunk {
+  std::uint64_t offset;
+  std::uint32_t storedSize;
+  std::uint32_t rawSize;
+  Codec codec;
+};
+
+struct BlockDesc {
+  std::uint64_t firstRow;
+  std::uint32_t nofRows;
+  std::vector<ColumnChunk> chunks; // one per column
+};
+
+struct IndexEntry {
+  std::int64_t eventID;
+  std::uint64_t firstRow;
+  std::uint64_t nofRows;
+};
+
+struct TableDesc {
+  std::string name;
+  std::uint64_t nofRows = 0;
+  std::vector<ColumnDesc> columns;
+  std::vector<BlockDesc> blocks;
+  std::uint64_t indexOffset = 0;
+  std::uint64_t nofIndexEntries = 0;
+};
+
+} // namespace ColumnarFormat
+
+#endif
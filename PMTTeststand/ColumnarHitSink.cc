@@ -0,0 +1,281 @@
+#include "ColumnarHitSink.hh"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef SANDBOX_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "globals.hh"
+
+using namespace ColumnarFormat;
+
+ColumnarHitSink::ColumnarHitSink(int blockRows, int compressionLevel,
+                                 const HitEncoding &encoding)
+    : fBlockRows(std::max(blockRows, 1)), fCompressionLevel(compressionLevel),
+      fEncoding(encoding) {
+  ColumnType wavelengthType = ColumnType::Float64;
+  if (fEncoding.wavelength == HitEncoding::Wavelength::Float)
+    wavelengthType = ColumnType::Float32;
+  else if (fEncoding.wavelength == HitEncoding::Wavelength::Fixed)
+    wavelengthType = ColumnType::Int32;
+  ColumnType timeType = fEncoding.time == HitEncoding::Time::Double
+                            ? ColumnType::Float64
+                            : ColumnType::Float32;
+
+  fPhotons.desc.name = "PhotonHits";
+  fPhotons.desc.columns = {{"evtID", ColumnType::Int64},
+                           {"det_uid", ColumnType::Int32},
+                           {fEncoding.WavelengthColumn(), wavelengthType},
+                           {fEncoding.TimeColumn(), timeType}};
+  if (fEncoding.weight)
+    fPhotons.desc.columns.push_back(
+        {"weight", fEncoding.trackWeight ? ColumnType::Float32
+                                         : ColumnType::Int32});
+  if (fEncoding.provenance)
+    fPhotons.desc.columns.push_back({"provenance", ColumnType::Int32});
+  fTotals.desc.name = "TotalHits";
+  fTotals.desc.columns = {{"evtID", ColumnType::Int64},
+                          {"det_uid", ColumnType::Int32},
+                          {"TotalHits", ColumnType::Int64}};
+}
+
+//==============================================================================
+
+bool ColumnarHitSink::Open(const std::string &baseName) {
+  std::string fileName = baseName + ".scol";
+  fFile = std::fopen(fileName.c_str(), "wb");
+  if (!fFile) {
+    G4cerr << "Error: Could not open columnar output " << fileName << G4endl;
+    return false;
+  }
+  fOffset = 0;
+  for (auto table : {&fPhotons, &fTotals}) {
+    table->desc.nofRows = 0;
+    table->desc.blocks.clear();
+    table->buffers.assign(table->desc.columns.size(), {});
+    for (size_t i = 0; i < table->buffers.size(); ++i) {
+      table->buffers[i].reserve(fBlockRows *
+                                SizeOf(table->desc.columns[i].type));
+    }
+    table->bufferedRows = 0;
+    table->index.clear();
+  }
+  WriteBytes(kMagic, sizeof(kMagic));
+  return true;
+}
+
+//==============================================================================
+
+void ColumnarHitSink::Write(const HitBlock &block) {
+  const auto &photons = block.photons;
+  if (!photons.Empty()) {
+    const void *wavelength = photons.wavelength.data();
+    if (fEncoding.wavelength == HitEncoding::Wavelength::Float) {
+      fFloatWavelength.assign(photons.wavelength.begin(),
+                              photons.wavelength.end());
+      wavelength = fFloatWavelength.data();
+    } else if (fEncoding.wavelength == HitEncoding::Wavelength::Fixed) {
+      fFixedWavelength.resize(photons.Size());
+      for (size_t i = 0; i < photons.Size(); ++i)
+        fFixedWavelength[i] =
+            HitEncoding::FixedWavelength(photons.wavelength[i]);
+      wavelength = fFixedWavelength.data();
+    }
+
+    const void *time = photons.time.data();
+    if (fEncoding.time == HitEncoding::Time::Float) {
+      fFloatTime.assign(photons.time.begin(), photons.time.end());
+      time = fFloatTime.data();
+    } else if (fEncoding.time == HitEncoding::Time::Delta) {
+      // Every block holds complete events
+      TimeDeltaEncoder encoder;
+      fFloatTime.resize(photons.Size());
+      for (size_t i = 0; i < photons.Size(); ++i)
+        fFloatTime[i] = encoder.Encode(photons.eventID[i], photons.time[i]);
+      time = fFloatTime.data();
+    }
+
+    std::vector<const void *> columns = {photons.eventID.data(),
+                                         photons.copyNr.data(), wavelength,
+                                         time};
+    if (fEncoding.weight && fEncoding.trackWeight) {
+      columns.push_back(photons.weight.data());
+    } else if (fEncoding.weight) {
+      fIntWeight.assign(photons.weight.begin(), photons.weight.end());
+      columns.push_back(fIntWeight.data());
+    }
+    if (fEncoding.provenance)
+      columns.push_back(photons.provenance.data());
+    AddToIndex(fPhotons, photons.eventID);
+    Append(fPhotons, columns, photons.Size());
+  }
+  const auto &totals = block.totals;
+  if (!totals.Empty()) {
+    AddToIndex(fTotals, totals.eventID);
+    Append(fTotals,
+           {totals.eventID.data(), totals.copyNr.data(), totals.count.data()},
+           totals.Size());
+  }
+}
+
+//==============================================================================
+
+void ColumnarHitSink::Close() {
+  if (!fFile)
+    return;
+  for (auto table : {&fPhotons, &fTotals}) {
+    FlushBlock(*table);
+    WriteIndex(*table);
+  }
+  WriteFooter();
+  std::fclose(fFile);
+  fFile = nullptr;
+}
+
+//==============================================================================
+
+void ColumnarHitSink::Append(Table &table,
+                             const std::vector<const void *> &columns,
+                             std::size_t nofRows) {
+  // The rows are copied column by column, split at the block boundaries
+  std::size_t done = 0;
+  while (done < nofRows) {
+    std::size_t n =
+        std::min<std::size_t>(nofRows - done, fBlockRows - table.bufferedRows);
+    for (size_t i = 0; i < columns.size(); ++i) {
+      std::size_t size = SizeOf(table.desc.columns[i].type);
+      auto first = static_cast<const char *>(columns[i]) + done * size;
+      table.buffers[i].insert(table.buffers[i].end(), first, first + n * size);
+    }
+    table.bufferedRows += n;
+    done += n;
+    if (table.bufferedRows == fBlockRows)
+      FlushBlock(table);
+  }
+}
+
+//==============================================================================
+
+void ColumnarHitSink::AddToIndex(Table &table,
+                                 const std::vector<std::int64_t> &eventIDs) {
+  // Rows of one event are contiguous, so every change of the event ID starts
+  // a new index entry
+  std::uint64_t row = table.desc.nofRows + table.bufferedRows;
+  for (size_t i = 0; i < eventIDs.size(); ++i, ++row) {
+    if (!table.index.empty() && table.index.back().eventID == eventIDs[i] &&
+        table.index.back().firstRow + table.index.back().nofRows == row) {
+      table.index.back().nofRows++;
+    } else {
+      table.index.push_back({eventIDs[i], row, 1});
+    }
+  }
+}
+
+//==============================================================================
+
+void ColumnarHitSink::FlushBlock(Table &table) {
+  if (table.bufferedRows == 0)
+    return;
+
+  BlockDesc block;
+  block.firstRow = table.desc.nofRows;
+  block.nofRows = table.bufferedRows;
+  for (auto &buffer : table.buffers) {
+    ColumnChunk chunk;
+    chunk.offset = fOffset;
+    chunk.rawSize = buffer.size();
+    chunk.storedSize = buffer.size();
+    chunk.codec = Codec::Raw;
+#ifdef SANDBOX_WITH_ZSTD
+    if (fCompressionLevel > 0) {
+      fCompressed.resize(ZSTD_compressBound(buffer.size()));
+      size_t size = ZSTD_compress(fCompressed.data(), fCompressed.size(),
+                                  buffer.data(), buffer.size(),
+                                  fCompressionLevel);
+      // Keep the block uncompressed if compression does not pay off
+      if (!ZSTD_isError(size) && size < buffer.size()) {
+        chunk.storedSize = size;
+        chunk.codec = Codec::Zstd;
+      }
+    }
+#endif
+    if (chunk.codec == Codec::Raw)
+      WriteBytes(buffer.data(), buffer.size());
+    else
+      WriteBytes(fCompressed.data(), chunk.storedSize);
+    block.chunks.push_back(chunk);
+    buffer.clear();
+  }
+  table.desc.blocks.push_back(block);
+  table.desc.nofRows += table.bufferedRows;
+  table.bufferedRows = 0;
+}
+
+//==============================================================================
+
+void ColumnarHitSink::WriteIndex(Table &table) {
+  // Events of different threads arrive interleaved
+  std::stable_sort(table.index.begin(), table.index.end(),
+                   [](const IndexEntry &a, const IndexEntry &b) {
+                     return a.eventID < b.eventID;
+                   });
+  static const char padding[8] = {};
+  WriteBytes(padding, (8 - fOffset % 8) % 8);
+  table.desc.indexOffset = fOffset;
+  table.desc.nofIndexEntries = table.index.size();
+  WriteBytes(table.index.data(), table.index.size() * sizeof(IndexEntry));
+}
+
+//==============================================================================
+
+void ColumnarHitSink::WriteFooter() {
+  std::uint64_t footerOffset = fOffset;
+  WriteU32(2);
+  for (auto table : {&fPhotons, &fTotals}) {
+    const auto &desc = table->desc;
+    WriteString(desc.name);
+    WriteU64(desc.nofRows);
+    WriteU32(desc.columns.size());
+    for (const auto &column : desc.columns) {
+      WriteString(column.name);
+      WriteU8(static_cast<std::uint8_t>(column.type));
+    }
+    WriteU32(desc.blocks.size());
+    for (const auto &block : desc.blocks) {
+      WriteU64(block.firstRow);
+      WriteU32(block.nofRows);
+      for (const auto &chunk : block.chunks) {
+        WriteU64(chunk.offset);
+        WriteU32(chunk.storedSize);
+        WriteU32(chunk.rawSize);
+        WriteU8(static_cast<std::uint8_t>(chunk.codec));
+      }
+    }
+    WriteU64(desc.indexOffset);
+    WriteU64(desc.nofIndexEntries);
+  }
+  WriteU64(footerOffset);
+  WriteBytes(kEndMagic, sizeof(kEndMagic));
+}
+
+//==============================================================================
+
+void ColumnarHitSink::WriteBytes(const void *data, std::size_t size) {
+  if (size == 0)
+    return;
+  if (std::fwrite(data, 1, size, fFile) != size) {
+    G4cerr << "Error: Writing columnar output failed" << G4endl;
+  }
+  fOffset += size;
+}
+
+//==============================================================================
+
+void ColumnarHitSink::WriteString(const std::string &value) {
+  WriteU32(value.size());
+  WriteBytes(value.data(), value.size());
+}
+
+//==============================================================================
@@ -0,0 +1,60 @@
+#ifndef COLUMNAR_HIT_SINK_HH
+#define COLUMNAR_HIT_SINK_HH
+
+#include <cstdio>
+
+#include "ColumnarFormat.hh"
+#include "HitEncoding.hh"
+#include "HitSink.hh"
+
+// Writes the PhotonHits and TotalHits tables into one <baseName>.scol file,
+// see ColumnarFormat.hh for the layout. Can be read with ColumnarFile
+class ColumnarHitSink : public HitSink {
+public:
+  ColumnarHitSink(int blockRows, int compressionLevel,
+                  const HitEncoding &encoding);
+
+  bool Open(const std::string &baseName) override;
+  void Write(const HitBlock &block) override;
+  void Close() override;
+  std::uint64_t GetBytesWritten() const override { return fOffset; }
+
+private:
+  // Table being written: the rows of the current block and the descriptors
+  // of everything that is already in the file
+  struct Table {
+    ColumnarFormat::TableDesc desc;
+    std::vector<std::vector<char>> buffers; // one per column
+    std::uint32_t bufferedRows = 0;
+    std::vector<ColumnarFormat::IndexEntry> index;
+  };
+
+  void Append(Table &table, const std::vector<const void *> &columns,
+              std::size_t nofRows);
+  void AddToIndex(Table &table, const std::vector<std::int64_t> &eventIDs);
+  void FlushBlock(Table &table);
+  void WriteIndex(Table &table);
+  void WriteFooter();
+
+  void WriteBytes(const void *data, std::size_t size);
+  void WriteU8(std::uint8_t value) { WriteBytes(&value, 1); }
+  void WriteU32(std::uint32_t value) { WriteBytes(&value, 4); }
+  void WriteU64(std::uint64_t value) { WriteBytes(&value, 8); }
+  void WriteString(const std::string &value);
+
+  std::uint32_t fBlockRows;
+  int fCompressionLevel;
+  HitEncoding fEncoding;
+  std::FILE *fFile = nullptr;
+  std::uint64_t fOffset = 0;
+  Table fPhotons;
+  Table fTotals;
+  std::vector<char> fCompressed; // scratch buffer for the compression
+  // Scratch buffers for the encoded wavelength, time and weight columns
+  std::vector<std::int32_t> fFixedWavelength;
+  std::vector<float> fFloatWavelength;
+  std::vector<float> fFloatTime;
+  std::vector<std::int32_t> fIntWeight;
+};
+
+#endif
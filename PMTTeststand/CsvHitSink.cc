@@ -0,0 +1,216 @@
+#include "CsvHitSink.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "globals.hh"
+
+namespace {
+
+// Longest possible row: two 64-bit ints, two ints and two doubles
+constexpr std::size_t kMaxRowLength = 128;
+
+template <typename T> char *FormatInt(char *first, char *last, T value) {
+  return std::to_chars(first, last, value).ptr;
+}
+
+// Same representation as the Geant4 csv output (std::ostream defaults)
+template <typename T> char *FormatFloat(char *first, char *last, T value) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  return std::to_chars(first, last, value, std::chars_format::general, 6).ptr;
+#else
+  // Standard libraries without floating point to_chars
+  return first + std::snprintf(first, last - first, "%g", double(value));
+#endif
+}
+
+} // namespace
+
+//==============================================================================
+
+CsvHitSink::CsvHitSink(std::size_t bufferSize, const HitEncoding &encoding)
+    : fBufferSize(std::max(bufferSize, 4 * kMaxRowLength)),
+      fEncoding(encoding) {}
+
+//==============================================================================
+
+CsvHitSink::~CsvHitSink() { Close(); }
+
+//==============================================================================
+
+bool CsvHitSink::Open(const std::string &baseName) {
+  std::string wavelengthType = "double";
+  if (fEncoding.wavelength == HitEncoding::Wavelength::Float)
+    wavelengthType = "float";
+  else if (fEncoding.wavelength == HitEncoding::Wavelength::Fixed)
+    wavelengthType = "int";
+  std::string timeType =
+      fEncoding.time == HitEncoding::Time::Double ? "double" : "float";
+
+  std::string photonsHeader =
+      "#class tools::wcsv::ntuple\n"
+      "#title PhotonHits\n"
+      "#separator 44\n"
+      "#vector_separator 59\n"
+      "#column int64 evtID\n"
+      "#column int det_uid\n"
+      "#column " + wavelengthType + " " + fEncoding.WavelengthColumn() + "\n"
+      "#column " + timeType + " " + fEncoding.TimeColumn() + "\n";
+  if (fEncoding.weight)
+    photonsHeader += "#column " + fEncoding.WeightType() + " weight\n";
+  if (fEncoding.provenance)
+    photonsHeader += "#column int provenance\n";
+  bool photonsOpen = OpenOutput(fPhotons, baseName + "_nt_PhotonHits.csv",
+                                photonsHeader);
+  bool totalsOpen = OpenOutput(fTotals, baseName + "_nt_TotalHits.csv",
+                               "#class tools::wcsv::ntuple\n"
+                               "#title TotalHits\n"
+                               "#separator 44\n"
+                               "#vector_separator 59\n"
+                               "#column int64 evtID\n"
+                               "#column int det_uid\n"
+                               "#column int64 TotalHits\n");
+  if (!photonsOpen || !totalsOpen) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+//==============================================================================
+
+void CsvHitSink::Write(const HitBlock &block) {
+  const auto &photons = block.photons;
+  TimeDeltaEncoder timeEncoder; // every block holds complete events
+  for (size_t i = 0; i < photons.Size(); ++i) {
+    char *p = Reserve(fPhotons);
+    char *last = fPhotons.buffer.data() + fPhotons.buffer.size();
+    p = FormatInt(p, last, photons.eventID[i]);
+    *p++ = ',';
+    p = FormatInt(p, last, photons.copyNr[i]);
+    *p++ = ',';
+    switch (fEncoding.wavelength) {
+    case HitEncoding::Wavelength::Double:
+      p = FormatFloat(p, last, photons.wavelength[i]);
+      break;
+    case HitEncoding::Wavelength::Float:
+      p = FormatFloat(p, last, float(photons.wavelength[i]));
+      break;
+    case HitEncoding::Wavelength::Fixed:
+      p = FormatInt(p, last,
+                    HitEncoding::FixedWavelength(photons.wavelength[i]));
+      break;
+    }
+    *p++ = ',';
+    switch (fEncoding.time) {
+    case HitEncoding::Time::Double:
+      p = FormatFloat(p, last, photons.time[i]);
+      break;
+    case HitEncoding::Time::Float:
+      p = FormatFloat(p, last, float(photons.time[i]));
+      break;
+    case HitEncoding::Time::Delta:
+      p = FormatFloat(p, last,
+                      timeEncoder.Encode(photons.eventID[i], photons.time[i]));
+      break;
+    }
+    if (fEncoding.weight) {
+      *p++ = ',';
+      if (fEncoding.trackWeight)
+        p = FormatFloat(p, last, photons.weight[i]);
+      else
+        p = FormatInt(p, last, static_cast<int>(photons.weight[i]));
+    }
+    if (fEncoding.provenance) {
+      *p++ = ',';
+      p = FormatInt(p, last, photons.provenance[i]);
+    }
+    *p++ = '\n';
+    fPhotons.used = p - fPhotons.buffer.data();
+  }
+  const auto &totals = block.totals;
+  for (size_t i = 0; i < totals.Size(); ++i) {
+    char *p = Reserve(fTotals);
+    char *last = fTotals.buffer.data() + fTotals.buffer.size();
+    p = FormatInt(p, last, totals.eventID[i]);
+    *p++ = ',';
+    p = FormatInt(p, last, totals.copyNr[i]);
+    *p++ = ',';
+    p = FormatInt(p, last, totals.count[i]);
+    *p++ = '\n';
+    fTotals.used = p - fTotals.buffer.data();
+  }
+}
+
+//==============================================================================
+
+void CsvHitSink::Close() {
+  CloseOutput(fPhotons);
+  CloseOutput(fTotals);
+}
+
+//==============================================================================
+
+std::uint64_t CsvHitSink::GetBytesWritten() const {
+  return fPhotons.flushed + fPhotons.used + fTotals.flushed + fTotals.used;
+}
+
+//==============================================================================
+
+bool CsvHitSink::OpenOutput(Output &output, const std::string &fileName,
+                            const std::string &header) {
+  output.fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (output.fd < 0) {
+    G4cerr << "Error: Could not open csv output " << fileName << G4endl;
+    return false;
+  }
+  output.buffer.resize(fBufferSize);
+  std::copy(header.begin(), header.end(), output.buffer.begin());
+  output.used = header.size();
+  output.flushed = 0;
+  return true;
+}
+
+//==============================================================================
+
+void CsvHitSink::CloseOutput(Output &output) {
+  if (output.fd < 0)
+    return;
+  Flush(output);
+  ::close(output.fd);
+  output.fd = -1;
+}
+
+//==============================================================================
+
+void CsvHitSink::Flush(Output &output) {
+  const char *data = output.buffer.data();
+  std::size_t left = output.used;
+  while (left > 0) {
+    ssize_t written = ::write(output.fd, data, left);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      G4cerr << "Error: Writing csv output failed" << G4endl;
+      break;
+    }
+    data += written;
+    left -= written;
+  }
+  output.flushed += output.used;
+  output.used = 0;
+}
+
+//==============================================================================
+
+char *CsvHitSink::Reserve(Output &output) {
+  if (output.buffer.size() - output.used < kMaxRowLength)
+    Flush(output);
+  return output.buffer.data() + output.used;
+}
+
+//==============================================================================
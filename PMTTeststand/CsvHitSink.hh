@@ -0,0 +1,44 @@
+#ifndef CSV_HIT_SINK_HH
+#define CSV_HIT_SINK_HH
+
+#include <vector>
+
+#include "HitEncoding.hh"
+#include "HitSink.hh"
+
+// Writes the PhotonHits and TotalHits ntuples with the same file names
+// (<baseName>_nt_<ntuple>.csv) and header as the Geant4 csv output. Rows are
+// formatted with std::to_chars into large buffers, and every full buffer is
+// written with a single write() call
+class CsvHitSink : public HitSink {
+public:
+  CsvHitSink(std::size_t bufferSize, const HitEncoding &encoding);
+  ~CsvHitSink();
+
+  bool Open(const std::string &baseName) override;
+  void Write(const HitBlock &block) override;
+  void Close() override;
+  std::uint64_t GetBytesWritten() const override;
+
+private:
+  struct Output {
+    int fd = -1;
+    std::vector<char> buffer;
+    std::size_t used = 0;
+    std::uint64_t flushed = 0;
+  };
+
+  bool OpenOutput(Output &output, const std::string &fileName,
+                  const std::string &header);
+  void CloseOutput(Output &output);
+  void Flush(Output &output);
+  // Makes sure one more row fits into the buffer and returns its end
+  char *Reserve(Output &output);
+
+  std::size_t fBufferSize;
+  HitEncoding fEncoding;
+  Output fPhotons;
+  Output fTotals;
+};
+
+#endif
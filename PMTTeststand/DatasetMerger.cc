@@ -0,0 +1,711 @@
+#include "DatasetMerger.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <condition_variable>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+
+#include "ColumnarFile.hh"
+#include "ColumnarHitSink.hh"
+#include "CsvHitSink.hh"
+
+#include "globals.hh"
+
+namespace fs = std::filesystem;
+using namespace ColumnarFormat;
+
+namespace {
+
+// Orders numbers in names by value, so output2 comes before output10
+bool NaturalLess(const std::string &a, const std::string &b) {
+  std::size_t i = 0, j = 0;
+  while (i < a.size() && j < b.size()) {
+    if (std::isdigit(a[i]) && std::isdigit(b[j])) {
+      std::size_t endA = a.find_first_not_of("0123456789", i);
+      std::size_t endB = b.find_first_not_of("0123456789", j);
+      endA = endA == std::string::npos ? a.size() : endA;
+      endB = endB == std::string::npos ? b.size() : endB;
+      std::string numberA = a.substr(i, endA - i);
+      std::string numberB = b.substr(j, endB - j);
+      numberA.erase(0, std::min(numberA.find_first_not_of('0'),
+                                numberA.size() - 1));
+      numberB.erase(0, std::min(numberB.find_first_not_of('0'),
+                                numberB.size() - 1));
+      if (numberA.size() != numberB.size())
+        return numberA.size() < numberB.size();
+      if (numberA != numberB)
+        return numberA < numberB;
+      i = endA;
+      j = endB;
+    } else {
+      if (a[i] != b[j])
+        return a[i] < b[j];
+      ++i;
+      ++j;
+    }
+  }
+  return a.size() - i < b.size() - j;
+}
+
+// Reconstructs the encoding from the column names and types of an input
+bool ParseEncoding(const std::string &wavelengthType,
+                   const std::string &wavelengthName,
+                   const std::string &timeType, const std::string &timeName,
+                   HitEncoding &encoding) {
+  if (wavelengthName == "wavelength_in_0p1nm" && wavelengthType == "int")
+    encoding.wavelength = HitEncoding::Wavelength::Fixed;
+  else if (wavelengthName == "wavelength_in_nm" && wavelengthType == "float")
+    encoding.wavelength = HitEncoding::Wavelength::Float;
+  else if (wavelengthName == "wavelength_in_nm" && wavelengthType == "double")
+    encoding.wavelength = HitEncoding::Wavelength::Double;
+  else
+    return false;
+
+  if (timeName == "time_delta_in_ns" && timeType == "float")
+    encoding.time = HitEncoding::Time::Delta;
+  else if (timeName == "time_in_ns" && timeType == "float")
+    encoding.time = HitEncoding::Time::Float;
+  else if (timeName == "time_in_ns" && timeType == "double")
+    encoding.time = HitEncoding::Time::Double;
+  else
+    return false;
+  return true;
+}
+
+std::string TypeName(ColumnType type) {
+  switch (type) {
+  case ColumnType::Int32:
+    return "int";
+  case ColumnType::Int64:
+    return "int64";
+  case ColumnType::Float32:
+    return "float";
+  case ColumnType::Float64:
+    return "double";
+  }
+  return "";
+}
+
+// Reads a column of any type converted to T
+template <typename T>
+bool ReadConverted(const ColumnarFile &file, const TableDesc &table,
+                   std::size_t column, std::vector<T> &values) {
+  auto read = [&](auto stored) {
+    using Stored = decltype(stored);
+    std::vector<Stored> data;
+    if (!file.ReadColumn(table, column, 0, table.nofRows, data))
+      return false;
+    values.assign(data.begin(), data.end());
+    return true;
+  };
+  switch (table.columns[column].type) {
+  case ColumnType::Int32:
+    return read(std::int32_t());
+  case ColumnType::Int64:
+    return read(std::int64_t());
+  case ColumnType::Float32:
+    return read(float());
+  case ColumnType::Float64:
+    return read(double());
+  }
+  return false;
+}
+
+// Undoes the encoding, the hits are buffered in nm and absolute ns
+void AddPhotons(const HitEncoding &encoding,
+                const std::vector<std::int64_t> &eventID,
+                const std::vector<int> &copyNr,
+                const std::vector<double> &wavelength,
+                const std::vector<double> &time,
+                const std::vector<float> &weight,
+                const std::vector<int> &provenance, PhotonHitBuffer &photons) {
+  photons.Reserve(photons.Size() + eventID.size());
+  double lastTime = 0.;
+  for (std::size_t i = 0; i < eventID.size(); ++i) {
+    double wavelengthInNm = wavelength[i];
+    if (encoding.wavelength == HitEncoding::Wavelength::Fixed)
+      wavelengthInNm *= HitEncoding::kWavelengthResolution;
+    double timeInNs = time[i];
+    if (encoding.time == HitEncoding::Time::Delta) {
+      if (i > 0 && eventID[i] == eventID[i - 1])
+        timeInNs += lastTime;
+      lastTime = timeInNs;
+    }
+    photons.Add(eventID[i], copyNr[i], wavelengthInNm, timeInNs,
+                weight.empty() ? 1.f : weight[i],
+                provenance.empty() ? 0 : provenance[i]);
+  }
+}
+
+// The optional columns follow the four fixed ones in this order. A float
+// weight column includes the track weight
+bool ParseOptionalColumns(const std::vector<std::string> &types,
+                          const std::vector<std::string> &names,
+                          HitEncoding &encoding) {
+  std::size_t column = 4;
+  encoding.weight = column < names.size() && names[column] == "weight";
+  encoding.trackWeight = encoding.weight && types[column] == "float";
+  if (encoding.weight)
+    column++;
+  encoding.provenance =
+      column < names.size() && names[column] == "provenance";
+  if (encoding.provenance)
+    column++;
+  return names.size() == column;
+}
+
+bool ReadFile(const std::string &fileName, std::string &content) {
+  std::ifstream in(fileName, std::ios::binary);
+  if (!in)
+    return false;
+  std::ostringstream stream;
+  stream << in.rdbuf();
+  content = stream.str();
+  return true;
+}
+
+// Parses the "#column <type> <name>" lines of a Geant4 style csv header and
+// returns the position of the first row
+std::size_t ParseCsvHeader(const std::string &content,
+                           std::vector<std::string> &types,
+                           std::vector<std::string> &names) {
+  std::size_t pos = 0;
+  while (pos < content.size() && content[pos] == '#') {
+    std::size_t end = content.find('\n', pos);
+    end = end == std::string::npos ? content.size() : end;
+    std::istringstream line(content.substr(pos, end - pos));
+    std::string tag, type, name;
+    line >> tag >> type >> name;
+    if (tag == "#column") {
+      types.push_back(type);
+      names.push_back(name);
+    }
+    pos = end + 1;
+  }
+  return pos;
+}
+
+// The last field of the file may also end without a newline
+bool IsSeparator(const char *p, const char *last) {
+  return p == last || *p == ',' || *p == '\n';
+}
+
+// Parses one comma or newline terminated field and moves behind it
+template <typename T>
+bool ParseInt(const char *&p, const char *last, T &value) {
+  auto result = std::from_chars(p, last, value);
+  if (result.ec != std::errc() || !IsSeparator(result.ptr, last))
+    return false;
+  p = result.ptr + 1;
+  return true;
+}
+
+bool ParseDouble(const char *&p, const char *last, double &value) {
+  // The content is null terminated, strtod stops at the separator
+  char *end;
+  value = std::strtod(p, &end);
+  if (end == p || !IsSeparator(end, last))
+    return false;
+  p = end + 1;
+  return true;
+}
+
+} // namespace
+
+//==============================================================================
+
+DatasetMerger::DatasetMerger(int nofThreads)
+    : fNofThreads(std::max(nofThreads, 1)) {}
+
+//==============================================================================
+
+int DatasetMerger::AddInput(const std::string &path) {
+  std::error_code error;
+  if (!fs::is_directory(path, error))
+    return AddFile(path);
+
+  // Other files in the directory are skipped without a warning
+  int nofDatasets = 0;
+  for (const auto &entry : fs::recursive_directory_iterator(path, error)) {
+    std::string name = entry.path().filename().string();
+    if (entry.is_regular_file() &&
+        (entry.path().extension() == ".scol" ||
+         (entry.path().extension() == ".csv" &&
+          (name.find("_nt_PhotonHits") != std::string::npos ||
+           name.find("_nt_TotalHits") != std::string::npos))))
+      nofDatasets += AddFile(entry.path().string());
+  }
+  return nofDatasets;
+}
+
+//==============================================================================
+
+int DatasetMerger::AddFile(const std::string &path) {
+  std::error_code error;
+  fs::path file = fs::weakly_canonical(path, error);
+  if (error || !fs::is_regular_file(file)) {
+    G4cerr << "Warning: Skipping " << path << ", it does not exist" << G4endl;
+    return 0;
+  }
+
+  Dataset dataset;
+  std::string name = file.filename().string();
+  if (file.extension() == ".scol") {
+    dataset.key = file.string();
+    dataset.scolFile = file.string();
+  } else if (file.extension() == ".csv") {
+    // Both ntuples of a run share everything but the ntuple name
+    for (const std::string tag : {"_nt_PhotonHits", "_nt_TotalHits"}) {
+      auto pos = name.rfind(tag);
+      if (pos == std::string::npos)
+        continue;
+      std::string prefix = name.substr(0, pos);
+      std::string suffix = name.substr(pos + tag.size());
+      dataset.key = (file.parent_path() / (prefix + "_nt_*" + suffix)).string();
+      dataset.photonsFile =
+          (file.parent_path() / (prefix + "_nt_PhotonHits" + suffix)).string();
+      dataset.totalsFile =
+          (file.parent_path() / (prefix + "_nt_TotalHits" + suffix)).string();
+      break;
+    }
+  }
+  if (dataset.key.empty()) {
+    G4cerr << "Warning: Skipping " << path
+           << ", only .scol files and PhotonHits/TotalHits csv files can be "
+              "merged"
+           << G4endl;
+    return 0;
+  }
+
+  // Both csv files of a dataset or the same file given twice
+  if (!fKeys.insert(dataset.key).second)
+    return 0;
+  fDatasets.push_back(dataset);
+  return 1;
+}
+
+//==============================================================================
+
+void DatasetMerger::SetEncoding(const HitEncoding &encoding) {
+  fEncoding = encoding;
+  fHasEncoding = true;
+}
+
+//==============================================================================
+
+bool DatasetMerger::Merge(const std::string &outputName, int blockRows,
+                          int compressionLevel) {
+  if (fDatasets.empty()) {
+    G4cerr << "Error: Nothing to merge" << G4endl;
+    return false;
+  }
+  std::size_t pos = outputName.find_last_of(".");
+  std::string extension =
+      pos == std::string::npos ? "" : outputName.substr(pos);
+  if (extension != ".csv" && extension != ".scol") {
+    G4cerr << "Error: The merged output has to be .csv or .scol" << G4endl;
+    return false;
+  }
+  std::string baseName = outputName.substr(0, pos);
+
+  // Runs and threads in the order of their numbers, which gives
+  // reproducible event IDs
+  std::sort(fDatasets.begin(), fDatasets.end(),
+            [](const Dataset &a, const Dataset &b) {
+              return NaturalLess(a.key, b.key);
+            });
+
+  // The workers read ahead of the output by a few datasets, as long as they
+  // fit into the memory limit. The next dataset of the output is always
+  // admitted, so a dataset above the limit does not stall the merge
+  const std::size_t nofDatasets = fDatasets.size();
+  const std::size_t window = 2 * fNofThreads;
+  for (auto &dataset : fDatasets)
+    dataset.memory = EstimateMemory(dataset);
+  std::uint64_t memoryInUse = 0;
+  std::vector<std::unique_ptr<Contents>> results(nofDatasets);
+  std::mutex mutex;
+  std::condition_variable readyCondition;
+  std::condition_variable spaceCondition;
+  std::size_t next = 0;
+  std::size_t consumed = 0;
+  bool abort = false;
+
+  auto work = [&]() {
+    while (true) {
+      std::size_t i;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        spaceCondition.wait(lock, [&] {
+          return abort || next >= nofDatasets ||
+                 (next < consumed + window &&
+                  (memoryInUse == 0 ||
+                   memoryInUse + fDatasets[next].memory <= fMemoryLimit));
+        });
+        if (abort || next >= nofDatasets)
+          return;
+        i = next++;
+        memoryInUse += fDatasets[i].memory;
+      }
+      auto contents = Read(fDatasets[i]);
+      std::lock_guard<std::mutex> lock(mutex);
+      results[i] = std::move(contents);
+      readyCondition.notify_all();
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int i = 0; i < fNofThreads; ++i)
+    workers.emplace_back(work);
+
+  std::unique_ptr<HitSink> sink;
+  HitEncoding encoding;
+  bool columnsDropped = false;
+  std::unordered_set<std::uint64_t> hashes;
+  std::int64_t eventOffset = 0;
+  std::uint64_t nofPhotons = 0;
+  int nofMerged = 0, nofDuplicates = 0, nofEmpty = 0, nofFailed = 0;
+  bool good = true;
+  // Gives the memory of the previous dataset back to the workers once it is
+  // written
+  auto release = [&](std::size_t i) {
+    std::lock_guard<std::mutex> lock(mutex);
+    memoryInUse -= fDatasets[i].memory;
+    spaceCondition.notify_all();
+  };
+  for (std::size_t i = 0; i < nofDatasets && good; ++i) {
+    if (i > 0)
+      release(i - 1);
+    std::unique_ptr<Contents> contents;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      readyCondition.wait(lock, [&] { return results[i] != nullptr; });
+      contents = std::move(results[i]);
+      consumed = i + 1;
+      spaceCondition.notify_all();
+    }
+
+    if (!contents->good) {
+      G4cerr << "Warning: Could not read " << fDatasets[i].key
+             << ", skipping it" << G4endl;
+      nofFailed++;
+      continue;
+    }
+    if (contents->nofEvents == 0) {
+      nofEmpty++; // e.g. the header-only csv files of the MT master
+      continue;
+    }
+    if (!hashes.insert(contents->hash).second) {
+      nofDuplicates++;
+      continue;
+    }
+
+    if (!sink) {
+      // The precision can be overridden, the optional columns are kept
+      encoding = contents->hasEncoding ? contents->encoding : HitEncoding();
+      if (fHasEncoding) {
+        encoding.wavelength = fEncoding.wavelength;
+        encoding.time = fEncoding.time;
+      }
+      if (extension == ".scol")
+        sink = std::make_unique<ColumnarHitSink>(blockRows, compressionLevel,
+                                                 encoding);
+      else
+        sink = std::make_unique<CsvHitSink>(4 << 20, encoding);
+      if (!sink->Open(baseName)) {
+        sink.reset();
+        good = false;
+        break;
+      }
+    }
+
+    if (((contents->encoding.weight && !encoding.weight) ||
+         (contents->encoding.trackWeight && !encoding.trackWeight) ||
+         (contents->encoding.provenance && !encoding.provenance)) &&
+        !columnsDropped) {
+      G4cerr << "Warning: " << fDatasets[i].key
+             << " has a weight or provenance column the first input does not "
+                "have, or a float weight where it has an int. These columns "
+                "are dropped or converted"
+             << G4endl;
+      columnsDropped = true;
+    }
+
+    auto &block = *contents->block;
+    for (auto &eventID : block.photons.eventID)
+      eventID += eventOffset;
+    for (auto &eventID : block.totals.eventID)
+      eventID += eventOffset;
+    sink->Write(block);
+    eventOffset += contents->nofEvents;
+    nofPhotons += block.photons.Size();
+    nofMerged++;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    abort = true;
+    spaceCondition.notify_all();
+  }
+  for (auto &worker : workers)
+    worker.join();
+  if (!good)
+    return false;
+
+  if (sink) {
+    sink->Close();
+  } else {
+    G4cerr << "Warning: None of the inputs holds any hits, nothing was "
+              "written"
+           << G4endl;
+  }
+  G4cout << "Merged " << nofMerged << " dataset(s) with " << eventOffset
+         << " events and " << nofPhotons << " photon hits into " << outputName
+         << G4endl;
+  if (nofDuplicates + nofEmpty + nofFailed > 0) {
+    G4cout << "Skipped " << nofDuplicates << " duplicate, " << nofEmpty
+           << " empty and " << nofFailed << " unreadable dataset(s)" << G4endl;
+  }
+  return nofFailed == 0;
+}
+
+//==============================================================================
+
+std::uint64_t DatasetMerger::EstimateMemory(const Dataset &dataset) {
+  // The values are read into vectors and then converted into the HitBlock,
+  // so every value is held twice, with up to 8 bytes each. Csv files are
+  // held as text while they are parsed, the parsed values take about as
+  // much
+  std::uint64_t memory = 0;
+  if (!dataset.scolFile.empty()) {
+    ColumnarFile file;
+    if (file.Open(dataset.scolFile)) {
+      for (const auto &table : file.GetTables())
+        memory += 2 * 8 * table.nofRows * table.columns.size();
+    }
+  } else {
+    std::error_code error;
+    for (const auto &fileName : {dataset.photonsFile, dataset.totalsFile}) {
+      auto size = fs::file_size(fileName, error);
+      if (!error)
+        memory += 2 * size;
+    }
+  }
+  return memory;
+}
+
+//==============================================================================
+
+std::unique_ptr<DatasetMerger::Contents>
+DatasetMerger::Read(const Dataset &dataset) {
+  auto contents = std::make_unique<Contents>();
+  bool good = true;
+  if (!dataset.scolFile.empty()) {
+    good = ReadColumnar(dataset.scolFile, *contents);
+  } else {
+    // A run may have been written with one of the ntuples disabled
+    std::error_code error;
+    if (fs::exists(dataset.photonsFile, error))
+      good = ReadPhotonsCsv(dataset.photonsFile, *contents);
+    if (good && fs::exists(dataset.totalsFile, error))
+      good = ReadTotalsCsv(dataset.totalsFile, *contents);
+  }
+  if (!good)
+    return contents;
+
+  contents->hash = Hash(*contents->block);
+  Renumber(*contents);
+  contents->good = true;
+  return contents;
+}
+
+//==============================================================================
+
+bool DatasetMerger::ReadColumnar(const std::string &fileName,
+                                 Contents &contents) {
+  ColumnarFile file;
+  if (!file.Open(fileName))
+    return false;
+
+  if (auto table = file.GetTable("PhotonHits")) {
+    const auto &columns = table->columns;
+    std::vector<std::string> types, names;
+    for (const auto &column : columns) {
+      types.push_back(TypeName(column.type));
+      names.push_back(column.name);
+    }
+    if (!ParseOptionalColumns(types, names, contents.encoding) ||
+        !ParseEncoding(TypeName(columns[2].type), columns[2].name,
+                       TypeName(columns[3].type), columns[3].name,
+                       contents.encoding))
+      return false;
+    contents.hasEncoding = true;
+
+    std::vector<std::int64_t> eventID;
+    std::vector<int> copyNr, provenance;
+    std::vector<float> weight;
+    std::vector<double> wavelength, time;
+    const std::size_t provenanceColumn = contents.encoding.weight ? 5 : 4;
+    if (!ReadConverted(file, *table, 0, eventID) ||
+        !ReadConverted(file, *table, 1, copyNr) ||
+        !ReadConverted(file, *table, 2, wavelength) ||
+        !ReadConverted(file, *table, 3, time) ||
+        (contents.encoding.weight &&
+         !ReadConverted(file, *table, 4, weight)) ||
+        (contents.encoding.provenance &&
+         !ReadConverted(file, *table, provenanceColumn, provenance)))
+      return false;
+    AddPhotons(contents.encoding, eventID, copyNr, wavelength, time, weight,
+               provenance, contents.block->photons);
+  }
+
+  if (auto table = file.GetTable("TotalHits")) {
+    auto &totals = contents.block->totals;
+    if (table->columns.size() != 3 ||
+        !ReadConverted(file, *table, 0, totals.eventID) ||
+        !ReadConverted(file, *table, 1, totals.copyNr) ||
+        !ReadConverted(file, *table, 2, totals.count))
+      return false;
+  }
+  return true;
+}
+
+//==============================================================================
+
+bool DatasetMerger::ReadPhotonsCsv(const std::string &fileName,
+                                   Contents &contents) {
+  std::string content;
+  if (!ReadFile(fileName, content))
+    return false;
+  std::vector<std::string> types, names;
+  std::size_t pos = ParseCsvHeader(content, types, names);
+  if (!ParseOptionalColumns(types, names, contents.encoding) ||
+      !ParseEncoding(types[2], names[2], types[3], names[3],
+                     contents.encoding))
+    return false;
+  contents.hasEncoding = true;
+  const bool hasWeight = contents.encoding.weight;
+  const bool hasProvenance = contents.encoding.provenance;
+  const bool trackWeight = contents.encoding.trackWeight;
+
+  std::vector<std::int64_t> eventID;
+  std::vector<int> copyNr, provenance;
+  std::vector<float> weight;
+  std::vector<double> wavelength, time;
+  const char *p = content.data() + pos;
+  const char *last = content.data() + content.size();
+  // The weight is an int of the thinning or a float with the track weight
+  auto parseWeight = [&](double &value) {
+    if (trackWeight)
+      return ParseDouble(p, last, value);
+    int thinning;
+    if (!ParseInt(p, last, thinning))
+      return false;
+    value = thinning;
+    return true;
+  };
+  while (p < last) {
+    std::int64_t id;
+    int copy, provenanceValue;
+    double wavelengthValue, timeValue, weightValue;
+    if (!ParseInt(p, last, id) || !ParseInt(p, last, copy) ||
+        !ParseDouble(p, last, wavelengthValue) ||
+        !ParseDouble(p, last, timeValue) ||
+        (hasWeight && !parseWeight(weightValue)) ||
+        (hasProvenance && !ParseInt(p, last, provenanceValue)))
+      return false;
+    eventID.push_back(id);
+    copyNr.push_back(copy);
+    wavelength.push_back(wavelengthValue);
+    time.push_back(timeValue);
+    if (hasWeight)
+      weight.push_back(weightValue);
+    if (hasProvenance)
+      provenance.push_back(provenanceValue);
+  }
+  AddPhotons(contents.encoding, eventID, copyNr, wavelength, time, weight,
+             provenance, contents.block->photons);
+  return true;
+}
+
+//==============================================================================
+
+bool DatasetMerger::ReadTotalsCsv(const std::string &fileName,
+                                  Contents &contents) {
+  std::string content;
+  if (!ReadFile(fileName, content))
+    return false;
+  std::vector<std::string> types, names;
+  std::size_t pos = ParseCsvHeader(content, types, names);
+  if (names.size() != 3)
+    return false;
+
+  auto &totals = contents.block->totals;
+  const char *p = content.data() + pos;
+  const char *last = content.data() + content.size();
+  while (p < last) {
+    std::int64_t id, count;
+    int copy;
+    if (!ParseInt(p, last, id) || !ParseInt(p, last, copy) ||
+        !ParseInt(p, last, count))
+      return false;
+    totals.Add(id, copy, count);
+  }
+  return true;
+}
+
+//==============================================================================
+
+void DatasetMerger::Renumber(Contents &contents) {
+  auto &photons = contents.block->photons;
+  auto &totals = contents.block->totals;
+  std::vector<std::int64_t> eventIDs(photons.eventID);
+  eventIDs.insert(eventIDs.end(), totals.eventID.begin(),
+                  totals.eventID.end());
+  std::sort(eventIDs.begin(), eventIDs.end());
+  eventIDs.erase(std::unique(eventIDs.begin(), eventIDs.end()),
+                 eventIDs.end());
+
+  auto renumber = [&](std::vector<std::int64_t> &ids) {
+    for (auto &id : ids)
+      id = std::lower_bound(eventIDs.begin(), eventIDs.end(), id) -
+           eventIDs.begin();
+  };
+  renumber(photons.eventID);
+  renumber(totals.eventID);
+  contents.nofEvents = eventIDs.size();
+}
+
+//==============================================================================
+
+std::uint64_t DatasetMerger::Hash(const HitBlock &block) {
+  // FNV-1a over the hits with their original event IDs, so copies of a
+  // dataset are detected independent of their file names. The csv files
+  // round the values, so a run written in both formats is not a copy
+  std::uint64_t hash = 14695981039346656037ull;
+  auto add = [&hash](const auto &values) {
+    auto bytes = reinterpret_cast<const unsigned char *>(values.data());
+    for (std::size_t i = 0; i < values.size() * sizeof(values[0]); ++i) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ull;
+    }
+    hash ^= values.size();
+    hash *= 1099511628211ull;
+  };
+  add(block.photons.eventID);
+  add(block.photons.copyNr);
+  add(block.photons.wavelength);
+  add(block.photons.time);
+  add(block.totals.eventID);
+  add(block.totals.copyNr);
+  add(block.totals.count);
+  return hash;
+}
+
+//==============================================================================
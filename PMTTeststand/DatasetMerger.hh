@@ -0,0 +1,74 @@
+#ifndef DATASET_MERGER_HH
+#define DATASET_MERGER_HH
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "HitBlock.hh"
+#include "HitEncoding.hh"
+
+// Merges the output of many runs and jobs (per-run, per-thread and rotated
+// files, .csv or .scol) into one dataset. The inputs are read in parallel and
+// written in a fixed order, their event IDs are renumbered globally, and
+// inputs holding the same hits as an earlier input are skipped
+class DatasetMerger {
+public:
+  explicit DatasetMerger(int nofThreads);
+
+  //! Adds a .scol file, a PhotonHits or TotalHits csv file or a directory
+  //! with such files. Returns the number of new datasets
+  int AddInput(const std::string &path);
+
+  //! Encoding of the merged output, by default the one of the first input
+  void SetEncoding(const HitEncoding &encoding);
+
+  //! Memory the datasets read ahead of the output may take. A dataset
+  //! larger than the limit is still read, but only while no other is
+  void SetMemoryLimit(std::uint64_t bytes) { fMemoryLimit = bytes; }
+
+  //! Writes the merged dataset to outputName (.csv or .scol)
+  bool Merge(const std::string &outputName, int blockRows,
+             int compressionLevel);
+
+private:
+  // One run of one thread or job: a .scol file or a pair of csv files
+  struct Dataset {
+    std::string key; // sorts the datasets and identifies duplicates
+    std::string scolFile;
+    std::string photonsFile;
+    std::string totalsFile;
+    std::uint64_t memory = 0; // estimated while it is read and written
+  };
+
+  // A dataset with the event IDs replaced by 0..nofEvents-1 in the order of
+  // the original IDs, so they only need an offset in the merged dataset
+  struct Contents {
+    bool good = false;
+    bool hasEncoding = false;
+    HitEncoding encoding;
+    std::unique_ptr<HitBlock> block = std::make_unique<HitBlock>();
+    std::int64_t nofEvents = 0;
+    std::uint64_t hash = 0;
+  };
+
+  int AddFile(const std::string &path);
+  static std::uint64_t EstimateMemory(const Dataset &dataset);
+  static std::unique_ptr<Contents> Read(const Dataset &dataset);
+  static bool ReadColumnar(const std::string &fileName, Contents &contents);
+  static bool ReadPhotonsCsv(const std::string &fileName, Contents &contents);
+  static bool ReadTotalsCsv(const std::string &fileName, Contents &contents);
+  static void Renumber(Contents &contents);
+  static std::uint64_t Hash(const HitBlock &block);
+
+  int fNofThreads;
+  bool fHasEncoding = false;
+  HitEncoding fEncoding;
+  std::uint64_t fMemoryLimit = std::uint64_t{4} << 30;
+  std::vector<Dataset> fDatasets;
+  std::set<std::string> fKeys;
+};
+
+#endif
@@ -305,6 +305,7 @@ void DetectorConstruction::ConstructSDandField() {
   auto sd_man = G4SDManager::GetSDMpointer();
   OpticalDetector *sensDet = new OpticalDetector("OpticalDetector");
   sd_man->AddNewDetector(sensDet);
+  sensDet->SetSensitiveVolume(fPMTLogical);
 
   this->SetSensitiveDetector(fPMTLogical, sensDet);
 }
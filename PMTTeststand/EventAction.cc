@@ -1,13 +1,16 @@
 #include "EventAction.hh"
+#include "OpticalHit.hh"
 
-#include "G4AnalysisManager.hh"
+#include "G4GenericAnalysisManager.hh"
 #include "G4RunManager.hh"
 #include <G4Event.hh>
 #include <G4SDManager.hh>
 #include <G4SystemOfUnits.hh>
 #include <G4THitsMap.hh>
 
-EventAction::EventAction(RunAction *RunAction) : fRunAction(RunAction) {}
+EventAction::EventAction(RunAction *RunAction) : fRunAction(RunAction) {
+  DefineCommands();
+}
 
 //==============================================================================
 
@@ -44,6 +47,59 @@ void EventAction::BeginOfEventAction(const G4Event *event) {
 
 //==============================================================================
 
-void EventAction::EndOfEventAction(const G4Event *event) {}
+void EventAction::EndOfEventAction(const G4Event *event) {
+  if (fPrintHits)
+    PrintHits(event);
+}
+
+//==============================================================================
+
+void EventAction::PrintHits(const G4Event *event) {
+  // Filled by the OpticalDetector with /Sandbox/Output/HitsCollection
+  if (fHitsCollectionID < 0)
+    fHitsCollectionID = G4SDManager::GetSDMpointer()->GetCollectionID(
+        "OpticalDetector/OpticalHits");
+  const auto hc_of_event = event->GetHCofThisEvent();
+  if (fHitsCollectionID < 0 || !hc_of_event)
+    return;
+  const auto hits = static_cast<const OpticalHitsCollection *>(
+      hc_of_event->GetHC(fHitsCollectionID));
+  if (!hits)
+    return;
+
+  for (std::size_t i = 0; i < hits->GetSize(); ++i) {
+    const auto hit = (*hits)[i];
+    const auto copy_nr = static_cast<std::size_t>(hit->GetCopyNr());
+    if (copy_nr >= fNofHits.size()) {
+      fNofHits.resize(copy_nr + 1, 0);
+      fFirstTime.resize(copy_nr + 1, 0.);
+    }
+    if (fNofHits[copy_nr]++ == 0 || hit->GetTime() < fFirstTime[copy_nr])
+      fFirstTime[copy_nr] = hit->GetTime();
+  }
+
+  G4cout << "Event " << event->GetEventID() << ": " << hits->GetSize()
+         << " optical hits" << G4endl;
+  for (std::size_t copy_nr = 0; copy_nr < fNofHits.size(); ++copy_nr) {
+    if (fNofHits[copy_nr] == 0)
+      continue;
+    G4cout << "  PMT " << copy_nr << ": " << fNofHits[copy_nr]
+           << " hits, first at " << fFirstTime[copy_nr] / ns << " ns"
+           << G4endl;
+    fNofHits[copy_nr] = 0;
+  }
+}
+
+//==============================================================================
+
+void EventAction::DefineCommands() {
+  fGenericMessenger = std::make_unique<G4GenericMessenger>(
+      this, "/Sandbox/Event/", "Control of the event action");
+
+  fGenericMessenger->DeclareProperty("PrintHits", fPrintHits)
+      .SetGuidance("Print the number of hits and the first arrival time per "
+                   "PMT of every event (needs /Sandbox/Output/HitsCollection)")
+      .SetStates(G4State_PreInit, G4State_Idle);
+}
 
 //==============================================================================
@@ -1,8 +1,11 @@
 #ifndef EVENTACTION_HH
 #define EVENTACTION_HH
 
+#include <G4GenericMessenger.hh>
 #include <G4UserEventAction.hh>
 #include <globals.hh>
+#include <memory>
+#include <vector>
 
 #include "RunAction.hh"
 
@@ -13,7 +16,17 @@ public:
   void EndOfEventAction(const G4Event *event) override;
 
 private:
+  void DefineCommands();
+  void PrintHits(const G4Event *event);
+
   RunAction *fRunAction;
+
+  std::unique_ptr<G4GenericMessenger> fGenericMessenger;
+  bool fPrintHits = false;
+  G4int fHitsCollectionID = -1;
+  // Per copy number, reused for every event
+  std::vector<int> fNofHits;
+  std::vector<G4double> fFirstTime;
 };
 
 #endif
@@ -0,0 +1,76 @@
+#include "EventTrigger.hh"
+
+#include <algorithm>
+
+EventTrigger::EventTrigger() { DefineCommands(); }
+
+//==============================================================================
+
+bool EventTrigger::Accept(std::int64_t nofPhotons, std::size_t nofHitPMTs) {
+  if (!IsEnabled())
+    return true;
+  // Cheap conditions first
+  const bool accepted = nofPhotons >= fMinPhotons &&
+                        nofHitPMTs >= static_cast<std::size_t>(fMinPMTs) &&
+                        WindowCondition();
+  fTimes.clear();
+  if (accepted)
+    return true;
+  // Prescaled events can be told apart by evaluating the trigger offline
+  return fPrescale > 0 && fNofFailed++ % fPrescale == 0;
+}
+
+//==============================================================================
+
+bool EventTrigger::WindowCondition() {
+  if (fWindowPhotons <= 0)
+    return true;
+  std::size_t n = fWindowPhotons;
+  if (fTimes.size() < n)
+    return false;
+  std::sort(fTimes.begin(), fTimes.end());
+  const double window = fWindow / ns;
+  for (std::size_t i = 0; i + n <= fTimes.size(); ++i) {
+    if (fTimes[i + n - 1] - fTimes[i] <= window)
+      return true;
+  }
+  return false;
+}
+
+//==============================================================================
+
+void EventTrigger::DefineCommands() {
+  fGenericMessenger = std::make_unique<G4GenericMessenger>(
+      this, "/Sandbox/Trigger/",
+      "Trigger deciding which events keep their photon hits");
+
+  fGenericMessenger->DeclareProperty("MinPhotons", fMinPhotons)
+      .SetGuidance("Minimum number of detected photons per event (0 = off)")
+      .SetParameterName("photons", false)
+      .SetRange("photons >= 0")
+      .SetStates(G4State_Idle);
+  fGenericMessenger->DeclareProperty("WindowPhotons", fWindowPhotons)
+      .SetGuidance("Minimum number of photons within the time window "
+                   "/Sandbox/Trigger/Window (0 = off)")
+      .SetParameterName("photons", false)
+      .SetRange("photons >= 0")
+      .SetStates(G4State_Idle);
+  fGenericMessenger->DeclarePropertyWithUnit("Window", "ns", fWindow)
+      .SetGuidance("Time window of /Sandbox/Trigger/WindowPhotons")
+      .SetParameterName("window", false)
+      .SetRange("window >= 0")
+      .SetStates(G4State_Idle);
+  fGenericMessenger->DeclareProperty("MinPMTs", fMinPMTs)
+      .SetGuidance("Minimum number of PMTs detecting light (0 = off)")
+      .SetParameterName("pmts", false)
+      .SetRange("pmts >= 0")
+      .SetStates(G4State_Idle);
+  fGenericMessenger->DeclareProperty("Prescale", fPrescale)
+      .SetGuidance("Keep the photon hits of 1 in this many events failing "
+                   "the trigger (0 = keep none)")
+      .SetParameterName("prescale", false)
+      .SetRange("prescale >= 0")
+      .SetStates(G4State_Idle);
+}
+
+//==============================================================================
@@ -0,0 +1,49 @@
+#ifndef EVENT_TRIGGER_HH
+#define EVENT_TRIGGER_HH
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "G4GenericMessenger.hh"
+#include "G4SystemOfUnits.hh"
+
+// Online trigger deciding which events keep their photon hits. All enabled
+// conditions have to be fulfilled. Each OpticalDetector (and therefore each
+// thread) owns one, so the prescale counts the events of one thread
+class EventTrigger {
+public:
+  EventTrigger();
+
+  //! True if any condition is enabled
+  bool IsEnabled() const {
+    return fMinPhotons > 0 || fWindowPhotons > 0 || fMinPMTs > 0;
+  }
+
+  //! Collects the time of every detected photon of the event, before the
+  //! hits are thinned or reduced to the earliest ones
+  void AddPhoton(double time) {
+    if (fWindowPhotons > 0)
+      fTimes.push_back(time);
+  }
+
+  //! Decides if the photon hits of the event are kept, from all photons
+  //! added since the last call
+  bool Accept(std::int64_t nofPhotons, std::size_t nofHitPMTs);
+
+private:
+  void DefineCommands();
+  bool WindowCondition();
+
+  int fMinPhotons = 0;         // photons per event, 0 = off
+  int fWindowPhotons = 0;      // photons within fWindow, 0 = off
+  G4double fWindow = 10. * ns; // coincidence window of fWindowPhotons
+  int fMinPMTs = 0;            // PMTs with light, 0 = off
+  int fPrescale = 0;           // keep 1 in fPrescale failing events, 0 = none
+  std::int64_t fNofFailed = 0;
+  std::vector<double> fTimes; // photon times of the current event, in ns
+
+  std::unique_ptr<G4GenericMessenger> fGenericMessenger;
+};
+
+#endif
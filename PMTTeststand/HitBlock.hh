@@ -0,0 +1,44 @@
+#ifndef HIT_BLOCK_HH
+#define HIT_BLOCK_HH
+
+#include <atomic>
+
+#include "MpscQueue.hh"
+#include "PhotonHitBuffer.hh"
+
+// Structure-of-arrays buffer for the integral light per event and detector
+struct TotalHitBuffer {
+  std::vector<std::int64_t> eventID;
+  std::vector<int> copyNr;
+  std::vector<std::int64_t> count;
+
+  void Add(std::int64_t evtID, int detID, std::int64_t lightCount) {
+    eventID.push_back(evtID);
+    copyNr.push_back(detID);
+    count.push_back(lightCount);
+  }
+
+  void Clear() {
+    eventID.clear();
+    copyNr.clear();
+    count.clear();
+  }
+
+  std::size_t Size() const { return eventID.size(); }
+  bool Empty() const { return eventID.empty(); }
+};
+
+// All output of one event of one thread. Blocks are handed to the HitWriter
+// thread and returned to their HitBlockPool once they have been written
+struct HitBlock : MpscNode {
+  PhotonHitBuffer photons;
+  TotalHitBuffer totals;
+  std::atomic<bool> inFlight{false}; // queued or being written
+
+  void Clear() {
+    photons.Clear();
+    totals.Clear();
+  }
+};
+
+#endif
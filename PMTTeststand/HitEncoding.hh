@@ -0,0 +1,94 @@
+#ifndef HIT_ENCODING_HH
+#define HIT_ENCODING_HH
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+// Storage precision of the PhotonHits columns, applied by every output
+// backend. The hits themselves are always buffered in double precision
+struct HitEncoding {
+  enum class Wavelength {
+    Double, // wavelength_in_nm, double
+    Float,  // wavelength_in_nm, float
+    Fixed   // wavelength_in_0p1nm, int with 0.1 nm resolution
+  };
+  enum class Time {
+    Double, // time_in_ns, double
+    Float,  // time_in_ns, float
+    Delta   // time_delta_in_ns, float: time since the previous hit of the
+            // same event, the first hit of an event holds the absolute time
+  };
+
+  static constexpr double kWavelengthResolution = 0.1; // in nm
+
+  Wavelength wavelength = Wavelength::Double;
+  Time time = Time::Double;
+  bool weight = false; // column weight of thinned or weighted photon hits
+  // The weight column is a float of the thinning times the track weight
+  // (e.g. of the surface source) instead of an int of the thinning
+  bool trackWeight = false;
+  bool provenance = false; // int column provenance, see PhotonProvenance.hh
+
+  bool operator==(const HitEncoding &other) const {
+    return wavelength == other.wavelength && time == other.time &&
+           weight == other.weight && trackWeight == other.trackWeight &&
+           provenance == other.provenance;
+  }
+  bool operator!=(const HitEncoding &other) const { return !(*this == other); }
+
+  std::string WavelengthColumn() const {
+    return wavelength == Wavelength::Fixed ? "wavelength_in_0p1nm"
+                                           : "wavelength_in_nm";
+  }
+  std::string TimeColumn() const {
+    return time == Time::Delta ? "time_delta_in_ns" : "time_in_ns";
+  }
+  std::string WeightType() const { return trackWeight ? "float" : "int"; }
+
+  static std::int32_t FixedWavelength(double wavelengthInNm) {
+    return std::lround(wavelengthInNm / kWavelengthResolution);
+  }
+
+  bool SetWavelength(const std::string &name) {
+    if (name == "double")
+      wavelength = Wavelength::Double;
+    else if (name == "float")
+      wavelength = Wavelength::Float;
+    else if (name == "fixed")
+      wavelength = Wavelength::Fixed;
+    else
+      return false;
+    return true;
+  }
+  bool SetTime(const std::string &name) {
+    if (name == "double")
+      time = Time::Double;
+    else if (name == "float")
+      time = Time::Float;
+    else if (name == "delta")
+      time = Time::Delta;
+    else
+      return false;
+    return true;
+  }
+};
+
+// Delta encoding of the hit times. Hits of one event have to be passed in a
+// row, the first hit of every event keeps its absolute time
+class TimeDeltaEncoder {
+public:
+  float Encode(std::int64_t eventID, double timeInNs) {
+    double delta = (eventID == fEventID) ? timeInNs - fLastTime : timeInNs;
+    fEventID = eventID;
+    fLastTime = timeInNs;
+    return delta;
+  }
+  void Reset() { fEventID = -1; }
+
+private:
+  std::int64_t fEventID = -1;
+  double fLastTime = 0.;
+};
+
+#endif
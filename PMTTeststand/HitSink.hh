@@ -0,0 +1,23 @@
+#ifndef HIT_SINK_HH
+#define HIT_SINK_HH
+
+#include <cstdint>
+#include <string>
+
+#include "HitBlock.hh"
+
+// Output backend of the HitWriter. All methods are only called from the
+// writer thread (Open() and Close() from the thread owning the writer)
+class HitSink {
+public:
+  virtual ~HitSink() = default;
+
+  //! Opens the output for one run, baseName is the file name without extension
+  virtual bool Open(const std::string &baseName) = 0;
+  virtual void Write(const HitBlock &block) = 0;
+  virtual void Close() = 0;
+  //! Size of the current output, used to roll over to a new file
+  virtual std::uint64_t GetBytesWritten() const = 0;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include "HitSorter.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <tuple>
+
+namespace {
+constexpr std::size_t kMinRadixSize = 128;
+} // namespace
+
+//==============================================================================
+
+void HitSorter::Sort(PhotonHitBuffer &photons) {
+  const std::size_t n = photons.Size();
+  if (n < 2)
+    return;
+
+  // Maps the IEEE 754 bit pattern to unsigned integers with the same order
+  fKeys.resize(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &photons.time[i], sizeof(bits));
+    fKeys[i] = (bits >> 63) ? ~bits : bits | (std::uint64_t(1) << 63);
+  }
+  fIndex.resize(n);
+  std::iota(fIndex.begin(), fIndex.end(), 0);
+
+  if (n < kMinRadixSize) {
+    // Clearing the radix histograms would cost more than sorting
+    const auto &copyNr = photons.copyNr;
+    std::stable_sort(fIndex.begin(), fIndex.end(),
+                     [this, &copyNr](std::uint32_t a, std::uint32_t b) {
+                       return std::tie(copyNr[a], fKeys[a]) <
+                              std::tie(copyNr[b], fKeys[b]);
+                     });
+  } else {
+    SortByTime(n);
+    SortByCopyNr(photons.copyNr);
+  }
+
+  Permute(photons.eventID);
+  Permute(photons.copyNr);
+  Permute(photons.wavelength);
+  Permute(photons.time);
+  Permute(photons.weight);
+  Permute(photons.provenance);
+}
+
+//==============================================================================
+
+void HitSorter::SortByTime(std::size_t n) {
+  // The histograms of all eight bytes are counted in a single pass
+  fCounts.assign(8 * 256, 0);
+  for (std::size_t i = 0; i < n; ++i) {
+    for (int byte = 0; byte < 8; ++byte)
+      fCounts[byte * 256 + ((fKeys[i] >> (8 * byte)) & 0xff)]++;
+  }
+
+  fKeysTmp.resize(n);
+  fIndexTmp.resize(n);
+  for (int byte = 0; byte < 8; ++byte) {
+    const int shift = 8 * byte;
+    auto counts = fCounts.begin() + byte * 256;
+    // The high bytes of times within one event are mostly equal
+    if (counts[(fKeys[0] >> shift) & 0xff] == n)
+      continue;
+    std::uint32_t offset = 0;
+    for (auto count = counts; count != counts + 256; ++count) {
+      std::uint32_t c = *count;
+      *count = offset;
+      offset += c;
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+      std::uint32_t pos = counts[(fKeys[i] >> shift) & 0xff]++;
+      fKeysTmp[pos] = fKeys[i];
+      fIndexTmp[pos] = fIndex[i];
+    }
+    fKeys.swap(fKeysTmp);
+    fIndex.swap(fIndexTmp);
+  }
+}
+
+//==============================================================================
+
+void HitSorter::SortByCopyNr(const std::vector<int> &copyNr) {
+  const std::size_t n = fIndex.size();
+  auto [minIt, maxIt] = std::minmax_element(copyNr.begin(), copyNr.end());
+  const int minCopyNr = *minIt;
+  const std::size_t range = std::size_t(*maxIt) - minCopyNr + 1;
+  if (range == 1)
+    return;
+  if (range > 4 * n + 1024) {
+    // Sparse copy numbers, counting would mostly clear empty buckets
+    std::stable_sort(fIndex.begin(), fIndex.end(),
+                     [&copyNr](std::uint32_t a, std::uint32_t b) {
+                       return copyNr[a] < copyNr[b];
+                     });
+    return;
+  }
+
+  fCounts.assign(range, 0);
+  for (std::size_t i = 0; i < n; ++i)
+    fCounts[copyNr[i] - minCopyNr]++;
+  std::uint32_t offset = 0;
+  for (auto &count : fCounts) {
+    std::uint32_t c = count;
+    count = offset;
+    offset += c;
+  }
+  fIndexTmp.resize(n);
+  for (std::size_t i = 0; i < n; ++i)
+    fIndexTmp[fCounts[copyNr[fIndex[i]] - minCopyNr]++] = fIndex[i];
+  fIndex.swap(fIndexTmp);
+}
+
+//==============================================================================
@@ -0,0 +1,40 @@
+#ifndef HIT_SORTER_HH
+#define HIT_SORTER_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "PhotonHitBuffer.hh"
+
+// Sorts the photon hits of an event by copy number and time. The times are
+// sorted with an LSD radix sort on their bit pattern, followed by a stable
+// counting sort on the copy numbers. Each OpticalDetector owns one, so the
+// scratch buffers are reused without locking
+class HitSorter {
+public:
+  //! Stable for hits with equal copy number and time
+  void Sort(PhotonHitBuffer &photons);
+
+private:
+  void SortByTime(std::size_t n);
+  void SortByCopyNr(const std::vector<int> &copyNr);
+  template <typename T> void Permute(std::vector<T> &values);
+
+  std::vector<std::uint64_t> fKeys, fKeysTmp;
+  std::vector<std::uint32_t> fIndex, fIndexTmp;
+  std::vector<std::uint32_t> fCounts;
+  std::vector<char> fScratch; // for Permute()
+};
+
+//==============================================================================
+
+template <typename T> void HitSorter::Permute(std::vector<T> &values) {
+  fScratch.resize(values.size() * sizeof(T));
+  T *sorted = reinterpret_cast<T *>(fScratch.data());
+  for (std::size_t i = 0; i < values.size(); ++i)
+    sorted[i] = values[fIndex[i]];
+  std::copy(sorted, sorted + values.size(), values.begin());
+}
+
+#endif
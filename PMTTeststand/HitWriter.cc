@@ -0,0 +1,208 @@
+#include "HitWriter.hh"
+
+#include <algorithm>
+#include <chrono>
+
+#include "globals.hh"
+
+HitWriter &HitWriter::Instance() {
+  static HitWriter instance;
+  return instance;
+}
+
+//==============================================================================
+
+HitWriter::~HitWriter() {
+  // Only reached if a run was aborted, do not write anything anymore
+  if (fThread.joinable()) {
+    fStop.store(true, std::memory_order_release);
+    fThread.join();
+  }
+}
+
+//==============================================================================
+
+bool HitWriter::Open(std::unique_ptr<HitSink> sink,
+                     const std::string &baseName, std::uint64_t maxBytes,
+                     std::uint64_t maxEvents) {
+  if (IsOpen())
+    Close();
+  fBaseName = baseName;
+  fMaxBytes = maxBytes;
+  fMaxEvents = maxEvents;
+  fPart = 0;
+  fEventsInFile = 0;
+  if (!sink->Open(RotationEnabled() ? PartName(fPart) : baseName))
+    return false;
+
+  fSink = std::move(sink);
+  fSinkOpen = true;
+  fBlocksDropped = 0;
+  fQueueDepth = 0;
+  fMaxQueueDepth = 0;
+  fStalls = 0;
+  fBlocksWritten = 0;
+  fPhotonsWritten = 0;
+  fWriteTime = 0.;
+  fStop.store(false);
+  fThread = std::thread(&HitWriter::Run, this);
+  fOpen.store(true, std::memory_order_release);
+  return true;
+}
+
+//==============================================================================
+
+void HitWriter::Close() {
+  if (!IsOpen())
+    return;
+  fStop.store(true, std::memory_order_release);
+  fThread.join();
+  if (fSinkOpen)
+    fSink->Close();
+  fSink.reset();
+  fOpen.store(false, std::memory_order_release);
+
+  G4cout << "HitWriter: wrote " << fPhotonsWritten << " photon hits in "
+         << fBlocksWritten << " blocks into " << fPart + 1 << " file(s) ("
+         << fWriteTime
+         << " s in the output backend), max. queue depth " << fMaxQueueDepth
+         << ", " << fStalls << " stalls of simulation threads" << G4endl;
+  if (fBlocksDropped > 0) {
+    G4cerr << "HitWriter: " << fBlocksDropped
+           << " events were lost because an output file could not be opened"
+           << G4endl;
+  }
+  if (fStalls > 0) {
+    G4cout << "HitWriter: simulation threads had to wait for the output. "
+              "Storage is the bottleneck, consider more blocks per thread "
+              "(/Sandbox/Output/WriterBlocks)"
+           << G4endl;
+  }
+}
+
+//==============================================================================
+
+void HitWriter::Push(HitBlock *block) {
+  block->inFlight.store(true, std::memory_order_relaxed);
+  long depth = fQueueDepth.fetch_add(1, std::memory_order_relaxed) + 1;
+  long maxDepth = fMaxQueueDepth.load(std::memory_order_relaxed);
+  while (depth > maxDepth &&
+         !fMaxQueueDepth.compare_exchange_weak(maxDepth, depth,
+                                               std::memory_order_relaxed)) {
+  }
+  fQueue.Push(block);
+}
+
+//==============================================================================
+
+void HitWriter::Run() {
+  int idleRounds = 0;
+  while (true) {
+    MpscNode *node = fQueue.Pop();
+    if (!node) {
+      // Close() is only called once all producers are done, so an empty
+      // queue after the stop request means everything has been written
+      if (fStop.load(std::memory_order_acquire) &&
+          fQueueDepth.load(std::memory_order_acquire) == 0)
+        break;
+      // Stay responsive while blocks keep coming, sleep if the queue stays
+      // empty for longer
+      if (++idleRounds < 1000)
+        std::this_thread::yield();
+      else
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+      continue;
+    }
+    idleRounds = 0;
+
+    // Only roll over once there is something for the next file
+    if ((fMaxBytes > 0 && fSink->GetBytesWritten() >= fMaxBytes) ||
+        (fMaxEvents > 0 && fEventsInFile >= fMaxEvents))
+      RollOver();
+
+    auto block = static_cast<HitBlock *>(node);
+    auto start = std::chrono::steady_clock::now();
+    if (fSinkOpen) {
+      fSink->Write(*block);
+      fBlocksWritten++;
+      fPhotonsWritten += block->photons.Size();
+    } else {
+      fBlocksDropped++;
+    }
+    fWriteTime += std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    fEventsInFile++;
+
+    fQueueDepth.fetch_sub(1, std::memory_order_release);
+    block->inFlight.store(false, std::memory_order_release);
+  }
+}
+
+//==============================================================================
+
+std::string HitWriter::PartName(int part) const {
+  return fBaseName + "_part" + std::to_string(part);
+}
+
+//==============================================================================
+
+void HitWriter::RollOver() {
+  // Closing finishes the current file, so it stays readable even if the run
+  // fails later on
+  fSink->Close();
+  fPart++;
+  fEventsInFile = 0;
+  fSinkOpen = fSink->Open(PartName(fPart));
+  if (!fSinkOpen) {
+    G4cerr << "Error: Could not open the next output file "
+           << PartName(fPart) << ", dropping its events" << G4endl;
+  }
+}
+
+//==============================================================================
+
+HitBlockPool::~HitBlockPool() {
+  // Blocks still queued must not be freed under the writer thread
+  for (auto &block : fBlocks) {
+    while (block->inFlight.load(std::memory_order_acquire) &&
+           HitWriter::Instance().IsOpen())
+      std::this_thread::yield();
+  }
+}
+
+//==============================================================================
+
+void HitBlockPool::Resize(int nofBlocks) {
+  fBlocks.resize(std::max(nofBlocks, 1));
+  for (auto &block : fBlocks) {
+    if (!block)
+      block = std::make_unique<HitBlock>();
+  }
+  fNext = 0;
+}
+
+//==============================================================================
+
+void HitBlockPool::Reserve(std::size_t nofHits) {
+  for (auto &block : fBlocks)
+    block->photons.Reserve(nofHits);
+}
+
+//==============================================================================
+
+HitBlock *HitBlockPool::Acquire() {
+  // Blocks are written in the order they were pushed, so the next block in
+  // turn is always the first one to become free again
+  HitBlock *block = fBlocks[fNext].get();
+  if (block->inFlight.load(std::memory_order_acquire)) {
+    HitWriter::Instance().CountStall();
+    while (block->inFlight.load(std::memory_order_acquire))
+      std::this_thread::yield();
+  }
+  fNext = (fNext + 1) % fBlocks.size();
+  block->Clear();
+  return block;
+}
+
+//==============================================================================
@@ -0,0 +1,95 @@
+#ifndef HIT_WRITER_HH
+#define HIT_WRITER_HH
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "HitBlock.hh"
+#include "HitSink.hh"
+#include "MpscQueue.hh"
+
+// Process-wide writer thread for the hit output. The worker threads push
+// their per-event HitBlocks into a lock-free queue and continue tracking,
+// the writer thread passes the blocks to the HitSink and hands them back.
+// Opened and closed by the master run action.
+//
+// The output can be split into several files (<baseName>_part<N>) once a
+// file reaches a size or number of events. The writer thread rolls over
+// between two blocks, so events are never split and the simulation threads
+// do not notice
+class HitWriter {
+public:
+  static HitWriter &Instance();
+
+  //! Starts the writer thread for one run. maxBytes/maxEvents > 0 start a
+  //! new file once the current one holds that many bytes or events
+  bool Open(std::unique_ptr<HitSink> sink, const std::string &baseName,
+            std::uint64_t maxBytes = 0, std::uint64_t maxEvents = 0);
+  //! Writes all queued blocks, stops the writer thread and prints counters
+  void Close();
+  bool IsOpen() const { return fOpen.load(std::memory_order_acquire); }
+
+  //! Queues a block for writing. Never blocks
+  void Push(HitBlock *block);
+  //! Called by a HitBlockPool that has to wait for a block to be written
+  void CountStall() { fStalls.fetch_add(1, std::memory_order_relaxed); }
+
+  long GetQueueDepth() const { return fQueueDepth.load(); }
+  long GetMaxQueueDepth() const { return fMaxQueueDepth.load(); }
+  long GetStalls() const { return fStalls.load(); }
+
+private:
+  HitWriter() = default;
+  ~HitWriter();
+
+  void Run();
+  bool RotationEnabled() const { return fMaxBytes > 0 || fMaxEvents > 0; }
+  std::string PartName(int part) const;
+  void RollOver();
+
+  MpscQueue fQueue;
+  std::thread fThread;
+  std::unique_ptr<HitSink> fSink;
+  bool fSinkOpen = false;
+  std::string fBaseName;
+  std::uint64_t fMaxBytes = 0;
+  std::uint64_t fMaxEvents = 0;
+  std::atomic<bool> fOpen{false};
+  std::atomic<bool> fStop{false};
+
+  std::atomic<long> fQueueDepth{0};
+  std::atomic<long> fMaxQueueDepth{0};
+  std::atomic<long> fStalls{0};
+  // Only touched by the writer thread while it is running
+  std::uint64_t fBlocksWritten = 0;
+  std::uint64_t fPhotonsWritten = 0;
+  std::uint64_t fBlocksDropped = 0;
+  std::uint64_t fEventsInFile = 0; // every block holds one event
+  int fPart = 0;
+  double fWriteTime = 0.; // in s
+};
+
+//==============================================================================
+
+// Per-thread set of HitBlocks that are filled in turn. With the default of
+// two blocks one is filled while the other one is written (double
+// buffering). The producer only waits if all of its blocks are still queued
+class HitBlockPool {
+public:
+  HitBlockPool(int nofBlocks = 2) { Resize(nofBlocks); }
+  ~HitBlockPool();
+
+  //! Must only be called while no block is in flight
+  void Resize(int nofBlocks);
+  void Reserve(std::size_t nofHits);
+  HitBlock *Acquire();
+
+private:
+  std::vector<std::unique_ptr<HitBlock>> fBlocks;
+  std::size_t fNext = 0;
+};
+
+#endif
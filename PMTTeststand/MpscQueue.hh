@@ -0,0 +1,57 @@
+#ifndef MPSC_QUEUE_HH
+#define MPSC_QUEUE_HH
+
+#include <atomic>
+
+// Node of an intrusive MpscQueue. Objects put into the queue derive from it
+struct MpscNode {
+  std::atomic<MpscNode *> next{nullptr};
+};
+
+// Lock-free intrusive multi-producer single-consumer queue (D. Vyukov).
+// Push() may be called from any thread, Pop() only from one consumer thread.
+// Pushing never blocks; Pop() returns nullptr if the queue is empty or if a
+// producer is in the middle of a push (the node shows up on the next Pop())
+class MpscQueue {
+public:
+  MpscQueue() : fHead(&fStub), fTail(&fStub) {}
+
+  void Push(MpscNode *node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    MpscNode *prev = fHead.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  MpscNode *Pop() {
+    MpscNode *tail = fTail;
+    MpscNode *next = tail->next.load(std::memory_order_acquire);
+    if (tail == &fStub) {
+      if (!next)
+        return nullptr;
+      fTail = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+      fTail = next;
+      return tail;
+    }
+    if (tail != fHead.load(std::memory_order_acquire))
+      return nullptr;
+    // tail is the last node, put the stub behind it so it can be handed out
+    Push(&fStub);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+      fTail = next;
+      return tail;
+    }
+    return nullptr;
+  }
+
+private:
+  MpscNode fStub;
+  std::atomic<MpscNode *> fHead; // written by the producers
+  MpscNode *fTail;               // only touched by the consumer
+};
+
+#endif
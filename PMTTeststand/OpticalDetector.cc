@@ -1,12 +1,39 @@
 #include "OpticalDetector.hh"
 
-#include "G4AnalysisManager.hh"
+#include "G4AccumulableManager.hh"
+#include "G4GenericAnalysisManager.hh"
+#include "G4Event.hh"
 #include "G4EventManager.hh"
+#include "G4NavigationHistory.hh"
 #include "G4OpticalPhoton.hh"
+#include "G4SDManager.hh"
 #include "G4SystemOfUnits.hh"
+#include "G4Run.hh"
+#include "Randomize.hh"
+#include "G4VPhysicalVolume.hh"
 
-OpticalDetector::OpticalDetector(G4String name) : G4VSensitiveDetector(name) {
+#include "PhotonProvenance.hh"
+#include "RunAction.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+// Attached by the TrackingAction while the provenance column is written
+std::uint32_t GetProvenance(const G4Track *track) {
+  const auto info = track->GetUserInformation();
+  return info ? static_cast<const PhotonProvenance *>(info)->GetPacked() : 0;
+}
+} // namespace
+
+OpticalDetector::OpticalDetector(G4String name)
+    : G4VSensitiveDetector(name),
+      fOpticalPhoton(G4OpticalPhoton::OpticalPhotonDefinition()) {
+  collectionName.insert("OpticalHits");
   DefineCommands();
+  fBlockPool.Reserve(fHitBufferSize);
+  fBlock = fBlockPool.Acquire();
 }
 
 //==============================================================================
@@ -17,7 +44,54 @@ OpticalDetector::~OpticalDetector() {}
 
 // Invoked at the beginning of each event
 void OpticalDetector::Initialize(G4HCofThisEvent *hit_coll) {
-  IntegralLightCounter.clear();
+  // Only reset the detectors hit in the last event
+  for (const auto copy_nr : fHitCopyNumbers)
+    fLightCounter[copy_nr] = 0;
+  fHitCopyNumbers.clear();
+
+  // The event owns the collection. Its vector is reserved for the largest
+  // event so far, so it does not grow hit by hit
+  fHitsCollection = nullptr;
+  if (fFillHitsCollection) {
+    fHitsCollection =
+        new OpticalHitsCollection(SensitiveDetectorName, collectionName[0]);
+    if (fHitsCollectionID < 0)
+      fHitsCollectionID =
+          G4SDManager::GetSDMpointer()->GetCollectionID(fHitsCollection);
+    fHitsCollection->GetVector()->reserve(fHitsCollectionCapacity);
+    hit_coll->AddHitsCollection(fHitsCollectionID, fHitsCollection);
+  }
+
+  auto event = G4EventManager::GetEventManager()->GetConstCurrentEvent();
+  fEventID = event ? event->GetEventID() : -1;
+  fUseHitWriter = HitWriter::Instance().IsOpen();
+  auto run_action = static_cast<const RunAction *>(
+      G4RunManager::GetRunManager()->GetUserRunAction());
+  fEncoding = run_action->GetHitEncoding();
+  fHistogramsOnly = run_action->GetHistogramsOnly();
+  fCathodeHitMap = run_action->GetCathodeHitMap();
+  // Every run writes a new file with event IDs starting at 0, so no time
+  // delta may refer to a hit of the previous run
+  const auto run = G4RunManager::GetRunManager()->GetCurrentRun();
+  if (run && run->GetRunID() != fRunID) {
+    fTimeEncoder.Reset();
+    fRunID = run->GetRunID();
+  }
+  fPhotonThinning = run_action->GetPhotonThinning();
+  fStatisticsOnly = run_action->GetStatisticsOnly();
+  if (!fPhotonsPerEvent) {
+    // Owned by the RunAction of this thread, so the pointers stay valid
+    auto acc_man = G4AccumulableManager::Instance();
+    fPhotonsPerEvent = static_cast<WelfordAccumulable *>(
+        acc_man->GetAccumulable("PhotonsPerEvent"));
+    fDetectedEvents = acc_man->GetAccumulable<std::int64_t>("DetectedEvents");
+    fPMTHits =
+        static_cast<PMTHitAccumulable *>(acc_man->GetAccumulable("PMTHits"));
+    fSortTime = acc_man->GetAccumulable<G4double>("SortTime");
+    fSortedHits = acc_man->GetAccumulable<std::int64_t>("SortedHits");
+    fDetectedWeight = acc_man->GetAccumulable<G4double>("DetectedWeight");
+    fDetectedWeight2 = acc_man->GetAccumulable<G4double>("DetectedWeight2");
+  }
 }
 
 //==============================================================================
@@ -26,55 +100,270 @@ G4bool OpticalDetector::ProcessHits(G4Step *step, G4TouchableHistory *ROhist) {
   // Is Optical?
   // ( •_•)
   // >⌐■--■⌐<
-  auto particle = step->GetTrack()->GetDefinition();
-  if (particle != G4OpticalPhoton::OpticalPhotonDefinition())
+  if (step->GetTrack()->GetDefinition() != fOpticalPhoton)
     return false;
 
   // Not relevant for now, use as crosscheck
-  auto touchable = step->GetPostStepPoint()->GetTouchableHandle();
-  const auto pv_name = touchable->GetVolume()->GetName();
-  const auto pv_copynr = touchable->GetCopyNumber();
-  if (pv_name != "PMT_phys") {
+  const auto post_step = step->GetPostStepPoint();
+  const auto touchable = post_step->GetTouchable();
+  if (fSensitiveVolume &&
+      touchable->GetVolume()->GetLogicalVolume() != fSensitiveVolume) {
     G4cerr << "Warning: Photon detected leaving PMT??" << G4endl;
     G4cerr << "No idea what G4 is doing. Skipping Photon." << G4endl;
     return false;
   }
+  const int pv_copynr = touchable->GetCopyNumber();
+  // The copy number indexes the per PMT counters here, in the statistics,
+  // the earliest hits and the printed hits collection
+  if (pv_copynr < 0) {
+    G4Exception("OpticalDetector::ProcessHits()", "Custom Code",
+                FatalException,
+                "PMT copy numbers have to be non-negative");
+  }
 
-  if (!fSurpressPhotonTimestamps) {
-    auto event = G4EventManager::GetEventManager()->GetNonconstCurrentEvent();
-    auto photon_wavelength =
-        CLHEP::c_light * CLHEP::h_Planck / step->GetTotalEnergyDeposit();
-    auto global_time = step->GetPostStepPoint()->GetGlobalTime();
+  // Acceptance weight of the surface source, 1 for the other sources. The
+  // histograms are filled with it, the hits only carry it with TrackWeights
+  const auto track_weight = step->GetTrack()->GetWeight();
+  *fDetectedWeight += track_weight;
+  *fDetectedWeight2 += track_weight * track_weight;
 
-    const auto ana_man = G4AnalysisManager::Instance();
-    int col_id = 0;
-    ana_man->FillNtupleIColumn(0, col_id++, event->GetEventID());
-    ana_man->FillNtupleIColumn(0, col_id++, pv_copynr);
-    ana_man->FillNtupleDColumn(0, col_id++, photon_wavelength / nm);
-    ana_man->FillNtupleDColumn(0, col_id++, global_time / ns);
-    // NOTE: must be called here for hit-oriented output
-    ana_man->AddNtupleRow(0);
+  if (fCathodeHitMap)
+    FillCathodeHitMap(touchable, post_step->GetPosition(), track_weight);
+  if (fHitsCollection) {
+    fHitsCollection->insert(new OpticalHit(
+        pv_copynr, post_step->GetGlobalTime(),
+        CLHEP::c_light * CLHEP::h_Planck / step->GetTotalEnergyDeposit(),
+        post_step->GetPosition(), GetProvenance(step->GetTrack())));
   }
-  IntegralLightCounter[pv_copynr]++;
+
+  // Thinning keeps a random 1 in k photon hits with weight k, the integral
+  // light below still counts every photon
+  const bool keep_photon =
+      !fStatisticsOnly &&
+      (fHistogramsOnly ||
+       (!fSurpressPhotonTimestamps &&
+        (fPhotonThinning == 1 || G4UniformRand() * fPhotonThinning < 1.)));
+  // The trigger sees every photon, so its decision does not depend on the
+  // thinning or the earliest hits
+  if (fTrigger.IsEnabled() && !fStatisticsOnly && !fHistogramsOnly)
+    fTrigger.AddPhoton(post_step->GetGlobalTime() / ns);
+
+  if (keep_photon) {
+    const auto photon_wavelength =
+        CLHEP::c_light * CLHEP::h_Planck / step->GetTotalEnergyDeposit() / nm;
+    const auto photon_time = post_step->GetGlobalTime() / ns;
+
+    if (fHistogramsOnly) {
+      // Thread-local histograms, merged by the master at the end of the run
+      const auto ana_man = G4GenericAnalysisManager::Instance();
+      ana_man->FillH1(RunAction::kWavelength, photon_wavelength, track_weight);
+      ana_man->FillH1(RunAction::kArrivalTime, photon_time, track_weight);
+      ana_man->FillH2(RunAction::kWavelengthVsTime, photon_time,
+                      photon_wavelength, track_weight);
+    } else {
+      const int photon_provenance = GetProvenance(step->GetTrack());
+      const float hit_weight =
+          fEncoding.trackWeight ? fPhotonThinning * track_weight
+                                : fPhotonThinning;
+      if (fEarliestHitsPerPMT > 0) {
+        KeepIfEarliest(pv_copynr, photon_wavelength, photon_time, hit_weight,
+                       photon_provenance);
+      } else {
+        // Only buffer the hit here, it is written in bulk. The trigger and
+        // the sorting need all hits of the event, so they are not flushed
+        // early
+        fBlock->photons.Add(fEventID, pv_copynr, photon_wavelength,
+                            photon_time, hit_weight, photon_provenance);
+        if (!fUseHitWriter && !fTrigger.IsEnabled() && !fSortHits &&
+            fBlock->photons.Size() >= static_cast<size_t>(fHitBufferSize))
+          FlushPhotonHits();
+      }
+    }
+  }
+
+  if (static_cast<size_t>(pv_copynr) >= fLightCounter.size())
+    fLightCounter.resize(pv_copynr + 1, 0);
+  if (fLightCounter[pv_copynr]++ == 0)
+    fHitCopyNumbers.push_back(pv_copynr);
   return true; // return is not used by geant4 kernel, so doesn't matter
 }
 
 //==============================================================================
 
 void OpticalDetector::EndOfEvent(G4HCofThisEvent *hit_coll) {
+  if (fHitsCollection)
+    fHitsCollectionCapacity =
+        std::max(fHitsCollectionCapacity, fHitsCollection->GetSize());
+
+  if (fStatisticsOnly || fHistogramsOnly) {
+    std::int64_t nof_photons = 0;
+    for (const auto detector_id : fHitCopyNumbers) {
+      nof_photons += fLightCounter[detector_id];
+      if (fStatisticsOnly)
+        fPMTHits->Fill(detector_id, fLightCounter[detector_id]);
+    }
+    if (fStatisticsOnly) {
+      fPhotonsPerEvent->Fill(nof_photons);
+      if (nof_photons > 0)
+        *fDetectedEvents += 1;
+    } else {
+      G4GenericAnalysisManager::Instance()->FillH1(
+          RunAction::kPhotonsPerEvent, nof_photons);
+    }
+    return;
+  }
+
+  // Write the detectors ordered by copy number
+  std::sort(fHitCopyNumbers.begin(), fHitCopyNumbers.end());
   if (!fSurpressIntegralLight) {
-    auto event = G4EventManager::GetEventManager()->GetNonconstCurrentEvent();
-    const auto ana_man = G4AnalysisManager::Instance();
-    for (const auto &[detector_id, light_count] : IntegralLightCounter) {
-      if (light_count > 0) {
-        int col_id = 0;
-        ana_man->FillNtupleIColumn(1, col_id++, event->GetEventID());
-        ana_man->FillNtupleIColumn(1, col_id++, detector_id);
-        ana_man->FillNtupleIColumn(1, col_id++, light_count);
-        ana_man->AddNtupleRow(1);
-      }
+    for (const auto detector_id : fHitCopyNumbers)
+      fBlock->totals.Add(fEventID, detector_id, fLightCounter[detector_id]);
+  }
+
+  if (fEarliestHitsPerPMT > 0) {
+    // The heaps are ordered by time, the latest hit on top
+    for (const auto detector_id : fHitCopyNumbers) {
+      auto &hits = fEarliestHits[detector_id];
+      std::sort_heap(hits.begin(), hits.end());
+      for (const auto &hit : hits)
+        fBlock->photons.Add(fEventID, detector_id, hit.wavelength, hit.time,
+                            hit.weight, hit.provenance);
+      hits.clear();
     }
   }
+
+  // The integral light is kept for every event, the photon hits only for
+  // events passing the trigger
+  // events passing the trigger. Events without light have nothing to keep
+  if (fTrigger.IsEnabled() && !fHitCopyNumbers.empty()) {
+    std::int64_t nof_photons = 0;
+    for (const auto detector_id : fHitCopyNumbers)
+      nof_photons += fLightCounter[detector_id];
+    if (!fTrigger.Accept(nof_photons, fHitCopyNumbers.size()))
+      fBlock->photons.Clear();
+  }
+
+  // The earliest hits are already emitted in this order
+  if (fSortHits && fEarliestHitsPerPMT == 0 && !fBlock->photons.Empty()) {
+    auto start = std::chrono::steady_clock::now();
+    fSorter.Sort(fBlock->photons);
+    *fSortTime += std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    *fSortedHits += fBlock->photons.Size();
+  }
+
+  if (!fUseHitWriter) {
+    FlushPhotonHits();
+    FlushTotalHits();
+  } else if (!fBlock->photons.Empty() || !fBlock->totals.Empty()) {
+    // The writer thread takes over the block, continue with the next one
+    HitWriter::Instance().Push(fBlock);
+    fBlock = fBlockPool.Acquire();
+  }
+}
+
+//==============================================================================
+
+void OpticalDetector::FillCathodeHitMap(const G4VTouchable *touchable,
+                                        const G4ThreeVector &position,
+                                        G4double weight) {
+  // The navigator keeps the global to local transform of the hit volume in
+  // the touchable of the step
+  const auto local =
+      touchable->GetHistory()->GetTopTransform().TransformPoint(position);
+
+  // The apex of the cathode points in -z
+  const auto ana_man = G4GenericAnalysisManager::Instance();
+  ana_man->FillH2(RunAction::kCathodeXY, local.x() / mm, local.y() / mm,
+                  weight);
+  ana_man->FillH2(RunAction::kCathodeThetaPhi, local.phi() / deg,
+                  std::acos(-local.z() / local.mag()) / deg, weight);
+}
+
+//==============================================================================
+
+void OpticalDetector::KeepIfEarliest(int copy_nr, double wavelength,
+                                     double time, float weight,
+                                     int provenance) {
+  if (static_cast<size_t>(copy_nr) >= fEarliestHits.size())
+    fEarliestHits.resize(copy_nr + 1);
+  auto &hits = fEarliestHits[copy_nr];
+  if (hits.size() < static_cast<size_t>(fEarliestHitsPerPMT)) {
+    hits.push_back({time, wavelength, weight, provenance});
+    std::push_heap(hits.begin(), hits.end());
+  } else if (time < hits.front().time) {
+    // Replace the latest of the kept hits
+    std::pop_heap(hits.begin(), hits.end());
+    hits.back() = {time, wavelength, weight, provenance};
+    std::push_heap(hits.begin(), hits.end());
+  }
+}
+
+//==============================================================================
+
+void OpticalDetector::FlushPhotonHits() {
+  const auto &photons = fBlock->photons;
+  if (photons.Empty())
+    return;
+  const auto ana_man = G4GenericAnalysisManager::Instance();
+  for (size_t i = 0; i < photons.Size(); ++i) {
+    int col_id = 0;
+    // Geant4 ntuples have no 64-bit integer columns, Geant4 event IDs are
+    // 32-bit anyway
+    ana_man->FillNtupleIColumn(0, col_id++, G4int(photons.eventID[i]));
+    ana_man->FillNtupleIColumn(0, col_id++, photons.copyNr[i]);
+    switch (fEncoding.wavelength) {
+    case HitEncoding::Wavelength::Double:
+      ana_man->FillNtupleDColumn(0, col_id++, photons.wavelength[i]);
+      break;
+    case HitEncoding::Wavelength::Float:
+      ana_man->FillNtupleFColumn(0, col_id++, photons.wavelength[i]);
+      break;
+    case HitEncoding::Wavelength::Fixed:
+      ana_man->FillNtupleIColumn(
+          0, col_id++, HitEncoding::FixedWavelength(photons.wavelength[i]));
+      break;
+    }
+    switch (fEncoding.time) {
+    case HitEncoding::Time::Double:
+      ana_man->FillNtupleDColumn(0, col_id++, photons.time[i]);
+      break;
+    case HitEncoding::Time::Float:
+      ana_man->FillNtupleFColumn(0, col_id++, photons.time[i]);
+      break;
+    case HitEncoding::Time::Delta:
+      // The encoder is kept across flushes, as they may split an event
+      ana_man->FillNtupleFColumn(
+          0, col_id++,
+          fTimeEncoder.Encode(photons.eventID[i], photons.time[i]));
+      break;
+    }
+    if (fEncoding.weight && fEncoding.trackWeight)
+      ana_man->FillNtupleFColumn(0, col_id++, photons.weight[i]);
+    else if (fEncoding.weight)
+      ana_man->FillNtupleIColumn(0, col_id++,
+                                 static_cast<int>(photons.weight[i]));
+    if (fEncoding.provenance)
+      ana_man->FillNtupleIColumn(0, col_id++, photons.provenance[i]);
+    ana_man->AddNtupleRow(0);
+  }
+  fBlock->photons.Clear();
+}
+
+//==============================================================================
+
+void OpticalDetector::FlushTotalHits() {
+  const auto &totals = fBlock->totals;
+  const auto ana_man = G4GenericAnalysisManager::Instance();
+  for (size_t i = 0; i < totals.Size(); ++i) {
+    int col_id = 0;
+    ana_man->FillNtupleIColumn(1, col_id++, G4int(totals.eventID[i]));
+    ana_man->FillNtupleIColumn(1, col_id++, totals.copyNr[i]);
+    ana_man->FillNtupleIColumn(1, col_id++, G4int(totals.count[i]));
+    ana_man->AddNtupleRow(1);
+  }
+  fBlock->totals.Clear();
 }
 
 //==============================================================================
@@ -91,6 +380,35 @@ void OpticalDetector::DefineCommands() {
       ->DeclareProperty("DisableIntegralLight", fSurpressIntegralLight)
       .SetGuidance("Disable storing integral light per event")
       .SetStates(G4State_Idle);
+  fGenericMessenger->DeclareProperty("EarliestHitsPerPMT", fEarliestHitsPerPMT)
+      .SetGuidance("Only keep the N earliest photon hits of every PMT in each "
+                   "event (0 = keep all hits)")
+      .SetParameterName("N", false)
+      .SetRange("N >= 0")
+      .SetStates(G4State_Idle);
+  fGenericMessenger->DeclareProperty("HitsCollection", fFillHitsCollection)
+      .SetGuidance("Fill the OpticalDetector/OpticalHits collection, e.g. for "
+                   "/vis/scene/add/hits or the EventAction")
+      .SetStates(G4State_Idle);
+  fGenericMessenger->DeclareProperty("SortHits", fSortHits)
+      .SetGuidance("Write the photon hits of each event sorted by PMT and "
+                   "time")
+      .SetStates(G4State_Idle);
+  fGenericMessenger
+      ->DeclareMethod("HitBufferSize", &OpticalDetector::SetHitBufferSize)
+      .SetGuidance("Number of photon hits buffered per thread before they are "
+                   "written (they are always written at the end of an event)")
+      .SetParameterName("size", false)
+      .SetRange("size > 0")
+      .SetStates(G4State_Idle);
+  fGenericMessenger
+      ->DeclareMethod("WriterBlocks", &OpticalDetector::SetWriterBlocks)
+      .SetGuidance("Number of event blocks per thread that can be queued for "
+                   "the async writer before the thread has to wait (2 = "
+                   "double buffering)")
+      .SetParameterName("blocks", false)
+      .SetRange("blocks > 1")
+      .SetStates(G4State_Idle);
 }
 
 //==============================================================================
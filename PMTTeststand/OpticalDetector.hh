@@ -1,11 +1,20 @@
 #ifndef _OPTICAL_DETECTOR_HH_
 #define _OPTICAL_DETECTOR_HH_
 
-#include "G4AnalysisManager.hh"
+#include "G4Accumulable.hh"
+#include "G4GenericAnalysisManager.hh"
 #include "G4GenericMessenger.hh"
+#include "G4LogicalVolume.hh"
 #include "G4RunManager.hh"
 #include "G4VSensitiveDetector.hh"
-#include <map>
+#include <vector>
+
+#include "EventTrigger.hh"
+#include "HitEncoding.hh"
+#include "HitSorter.hh"
+#include "HitWriter.hh"
+#include "OpticalHit.hh"
+#include "StatisticsAccumulables.hh"
 
 class OpticalDetector : public G4VSensitiveDetector {
 public:
@@ -16,13 +25,86 @@ public:
   bool ProcessHits(G4Step *step, G4TouchableHistory *history) override;
   void EndOfEvent(G4HCofThisEvent *hit_coll) override;
 
+  // Logical volume of the PMT cathode, used to crosscheck the hit volume
+  void SetSensitiveVolume(const G4LogicalVolume *volume) {
+    fSensitiveVolume = volume;
+  }
+
 private:
   void DefineCommands();
+  void FillCathodeHitMap(const G4VTouchable *touchable,
+                         const G4ThreeVector &position, G4double weight);
+  void KeepIfEarliest(int copy_nr, double wavelength, double time,
+                      float weight, int provenance);
+  void FlushPhotonHits();
+  void FlushTotalHits();
+  void SetHitBufferSize(int size) {
+    fHitBufferSize = size;
+    fBlockPool.Reserve(size);
+  }
+  void SetWriterBlocks(int nofBlocks) {
+    fBlockPool.Resize(nofBlocks);
+    fBlockPool.Reserve(fHitBufferSize);
+    fBlock = fBlockPool.Acquire();
+  }
+
+  // Light count per detector copy number, which ProcessHits checks to be
+  // non-negative. Only the entries listed in fHitCopyNumbers are non-zero,
+  // so resetting is cheap for many PMTs
+  std::vector<std::int64_t> fLightCounter;
+  std::vector<int> fHitCopyNumbers;
+
+  // Earliest hits per detector copy number, each a max-heap by time of at
+  // most fEarliestHitsPerPMT hits. Emptied at the end of every event
+  struct EarlyHit {
+    double time;       // in ns
+    double wavelength; // in nm
+    float weight;
+    int provenance;
+    bool operator<(const EarlyHit &other) const { return time < other.time; }
+  };
+  std::vector<std::vector<EarlyHit>> fEarliestHits;
+
+  G4int fRunID = -1; // of the last Initialize, to detect a new run
+
+  // Hits collection of the current event, nullptr if it is not filled
+  OpticalHitsCollection *fHitsCollection = nullptr;
+  G4int fHitsCollectionID = -1;
+  std::size_t fHitsCollectionCapacity = 0;
+
+  // Cached at construction and at the beginning of each event
+  const G4ParticleDefinition *fOpticalPhoton;
+  const G4LogicalVolume *fSensitiveVolume = nullptr;
+  std::int64_t fEventID = -1;
+  bool fUseHitWriter = false; // hand the blocks to the HitWriter thread
+  HitEncoding fEncoding;      // column precision of the analysis output
+  bool fHistogramsOnly = false; // fill histograms instead of rows
+  bool fCathodeHitMap = false;  // fill the cathode hit position maps
+  int fPhotonThinning = 1;      // keep 1 in k photon hits
+  bool fStatisticsOnly = false; // only fill the run statistics
+  TimeDeltaEncoder fTimeEncoder;
+
+  // Run statistics and timing, owned by the RunAction of this thread
+  WelfordAccumulable *fPhotonsPerEvent = nullptr;
+  G4Accumulable<std::int64_t> *fDetectedEvents = nullptr;
+  PMTHitAccumulable *fPMTHits = nullptr;
+  G4Accumulable<G4double> *fSortTime = nullptr;
+  G4Accumulable<std::int64_t> *fSortedHits = nullptr;
+  G4Accumulable<G4double> *fDetectedWeight = nullptr;
+  G4Accumulable<G4double> *fDetectedWeight2 = nullptr;
 
-  std::map<int, int>
-      IntegralLightCounter; // key: detector copy number, value: light count
+  // Output of the current event. Without the HitWriter it is flushed to the
+  // analysis manager at the end of event or when full
+  HitBlockPool fBlockPool;
+  HitBlock *fBlock;
+  EventTrigger fTrigger;
+  HitSorter fSorter;
 
   std::unique_ptr<G4GenericMessenger> fGenericMessenger;
+  int fHitBufferSize = 4096;
+  int fEarliestHitsPerPMT = 0; // 0 = keep all photon hits
+  bool fSortHits = false;      // sort the hits of each event by PMT and time
+  bool fFillHitsCollection = false;
   bool fSurpressPhotonTimestamps = false;
   bool fSurpressIntegralLight = false;
 };
@@ -0,0 +1,33 @@
+#include "OpticalHit.hh"
+
+#include "G4Circle.hh"
+#include "G4Colour.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4VVisManager.hh"
+#include "G4VisAttributes.hh"
+#include "G4ios.hh"
+
+G4ThreadLocal G4Allocator<OpticalHit> *OpticalHitAllocator = nullptr;
+
+//==============================================================================
+
+void OpticalHit::Draw() {
+  auto vis_man = G4VVisManager::GetConcreteInstance();
+  if (!vis_man)
+    return;
+  G4Circle circle(fPosition);
+  circle.SetScreenSize(4.);
+  circle.SetFillStyle(G4Circle::filled);
+  circle.SetVisAttributes(G4VisAttributes(G4Colour::Red()));
+  vis_man->Draw(circle);
+}
+
+//==============================================================================
+
+void OpticalHit::Print() {
+  G4cout << "OpticalHit: PMT " << fCopyNr << ", time " << fTime / ns
+         << " ns, wavelength " << fWavelength / nm << " nm, position "
+         << fPosition / mm << " mm" << G4endl;
+}
+
+//==============================================================================
@@ -0,0 +1,65 @@
+#ifndef OPTICAL_HIT_HH
+#define OPTICAL_HIT_HH
+
+#include <cstdint>
+
+#include "G4Allocator.hh"
+#include "G4THitsCollection.hh"
+#include "G4ThreeVector.hh"
+#include "G4VHit.hh"
+
+class OpticalHit;
+extern G4ThreadLocal G4Allocator<OpticalHit> *OpticalHitAllocator;
+
+// A detected optical photon, filled into the OpticalHits collection of the
+// OpticalDetector for the visualisation and in-process analysis. The hits
+// come from a thread-local G4Allocator pool, so after warm-up no memory is
+// allocated per hit
+class OpticalHit : public G4VHit {
+public:
+  OpticalHit(int copyNr, G4double time, G4double wavelength,
+             const G4ThreeVector &position, std::uint32_t provenance)
+      : fCopyNr(copyNr), fTime(time), fWavelength(wavelength),
+        fPosition(position), fProvenance(provenance) {}
+
+  inline void *operator new(size_t);
+  inline void operator delete(void *hit);
+
+  void Draw() override;
+  void Print() override;
+
+  int GetCopyNr() const { return fCopyNr; }
+  //! Global time, in Geant4 units
+  G4double GetTime() const { return fTime; }
+  //! In Geant4 units
+  G4double GetWavelength() const { return fWavelength; }
+  //! Global position
+  const G4ThreeVector &GetPosition() const { return fPosition; }
+  //! Packed PhotonProvenance, 0 if the photons are not tagged
+  std::uint32_t GetProvenance() const { return fProvenance; }
+
+private:
+  int fCopyNr;
+  G4double fTime;
+  G4double fWavelength;
+  G4ThreeVector fPosition;
+  std::uint32_t fProvenance;
+};
+
+using OpticalHitsCollection = G4THitsCollection<OpticalHit>;
+
+//==============================================================================
+
+inline void *OpticalHit::operator new(size_t) {
+  if (!OpticalHitAllocator)
+    OpticalHitAllocator = new G4Allocator<OpticalHit>;
+  return OpticalHitAllocator->MallocSingle();
+}
+
+//==============================================================================
+
+inline void OpticalHit::operator delete(void *hit) {
+  OpticalHitAllocator->FreeSingle(static_cast<OpticalHit *>(hit));
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include "OutputMerger.hh"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <future>
+
+#include "globals.hh"
+
+namespace fs = std::filesystem;
+
+int OutputMerger::MergeThreadCsvFiles(
+    const std::string &baseName, const std::vector<std::string> &ntupleNames) {
+  std::vector<std::future<int>> merges;
+  for (const auto &ntupleName : ntupleNames) {
+    merges.push_back(std::async(std::launch::async, &OutputMerger::MergeNtuple,
+                                baseName, ntupleName));
+  }
+  int nofFiles = 0;
+  for (auto &merge : merges) {
+    nofFiles += merge.get();
+  }
+  return nofFiles;
+}
+
+//==============================================================================
+
+int OutputMerger::MergeNtuple(const std::string &baseName,
+                              const std::string &ntupleName) {
+  fs::path base(baseName);
+  fs::path directory =
+      base.has_parent_path() ? base.parent_path() : fs::current_path();
+  std::string prefix = base.filename().string() + "_nt_" + ntupleName + "_t";
+
+  // Collect the thread files sorted by thread number
+  std::vector<std::pair<int, fs::path>> threadFiles;
+  for (const auto &entry : fs::directory_iterator(directory)) {
+    std::string name = entry.path().filename().string();
+    if (name.rfind(prefix, 0) != 0 || entry.path().extension() != ".csv")
+      continue;
+    std::string threadNr = name.substr(
+        prefix.size(), name.size() - prefix.size() - std::string(".csv").size());
+    if (threadNr.empty() ||
+        !std::all_of(threadNr.begin(), threadNr.end(), ::isdigit))
+      continue;
+    threadFiles.emplace_back(std::stoi(threadNr), entry.path());
+  }
+  if (threadFiles.empty())
+    return 0;
+  std::sort(threadFiles.begin(), threadFiles.end());
+
+  // The master file only holds the header, so it is overwritten
+  fs::path target = directory / (base.filename().string() + "_nt_" +
+                                 ntupleName + ".csv");
+  std::ofstream out(target, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    G4cerr << "Warning: Could not open " << target << " for merging" << G4endl;
+    return 0;
+  }
+
+  bool writeHeader = true;
+  std::string line;
+  for (const auto &[threadNr, file] : threadFiles) {
+    std::ifstream in(file, std::ios::binary);
+    // Header lines are commented with '#', keep them only once
+    while (in.peek() == '#' && std::getline(in, line)) {
+      if (writeHeader)
+        out << line << '\n';
+    }
+    writeHeader = false;
+    if (in.peek() != std::ifstream::traits_type::eof())
+      out << in.rdbuf();
+  }
+  out.close();
+  if (!out) {
+    G4cerr << "Warning: Merging into " << target << " failed, keeping the "
+           << "per-thread files" << G4endl;
+    return 0;
+  }
+
+  for (const auto &[threadNr, file] : threadFiles) {
+    fs::remove(file);
+  }
+  return threadFiles.size();
+}
+
+//==============================================================================
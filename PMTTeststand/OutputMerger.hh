@@ -0,0 +1,21 @@
+#ifndef OUTPUT_MERGER_HH
+#define OUTPUT_MERGER_HH
+
+#include <string>
+#include <vector>
+
+class OutputMerger {
+public:
+  //! Merges the per-thread csv files Geant4 writes in MT mode
+  //! (<baseName>_nt_<ntuple>_t<thread>.csv) into <baseName>_nt_<ntuple>.csv.
+  //! Every ntuple is merged in its own thread and the per-thread files are
+  //! removed afterwards. Returns the number of merged per-thread files
+  static int MergeThreadCsvFiles(const std::string &baseName,
+                                 const std::vector<std::string> &ntupleNames);
+
+private:
+  static int MergeNtuple(const std::string &baseName,
+                         const std::string &ntupleName);
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef PHOTON_HIT_BUFFER_HH
+#define PHOTON_HIT_BUFFER_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Structure-of-arrays buffer for detected photons. Each sensitive detector
+// (and therefore each thread) owns one, so filling it needs no locking.
+struct PhotonHitBuffer {
+  std::vector<std::int64_t> eventID;
+  std::vector<int> copyNr;
+  std::vector<double> wavelength; // in nm
+  std::vector<double> time;       // in ns
+  // Photons represented by the hit: the thinning, times the track weight if
+  // it is written
+  std::vector<float> weight;
+  std::vector<int> provenance;    // packed PhotonProvenance, 0 if not tagged
+
+  void Add(std::int64_t evtID, int detID, double wavelengthInNm,
+           double timeInNs, float hitWeight = 1.f, int hitProvenance = 0) {
+    eventID.push_back(evtID);
+    copyNr.push_back(detID);
+    wavelength.push_back(wavelengthInNm);
+    time.push_back(timeInNs);
+    weight.push_back(hitWeight);
+    provenance.push_back(hitProvenance);
+  }
+
+  void Reserve(std::size_t n) {
+    eventID.reserve(n);
+    copyNr.reserve(n);
+    wavelength.reserve(n);
+    time.reserve(n);
+    weight.reserve(n);
+    provenance.reserve(n);
+  }
+
+  // Keeps the capacity, so the buffer does not reallocate after warm-up
+  void Clear() {
+    eventID.clear();
+    copyNr.clear();
+    wavelength.clear();
+    time.clear();
+    weight.clear();
+    provenance.clear();
+  }
+
+  std::size_t Size() const { return eventID.size(); }
+  bool Empty() const { return eventID.empty(); }
+};
+
+#endif
@@ -0,0 +1,16 @@
+#include "PhotonProvenance.hh"
+
+#include "G4ios.hh"
+
+G4ThreadLocal G4Allocator<PhotonProvenance> *PhotonProvenanceAllocator =
+    nullptr;
+
+//==============================================================================
+
+void PhotonProvenance::Print() const {
+  G4cout << "PhotonProvenance: process " << GetProcess(fPacked) << ", volume "
+         << GetVolume(fPacked) << ", boundaries " << GetBoundaries(fPacked)
+         << G4endl;
+}
+
+//==============================================================================
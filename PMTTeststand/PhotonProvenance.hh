@@ -0,0 +1,86 @@
+#ifndef PHOTON_PROVENANCE_HH
+#define PHOTON_PROVENANCE_HH
+
+#include <cstdint>
+
+#include "G4Allocator.hh"
+#include "G4VUserTrackInformation.hh"
+
+class PhotonProvenance;
+extern G4ThreadLocal G4Allocator<PhotonProvenance> *PhotonProvenanceAllocator;
+
+// Origin of an optical photon, attached to its track by the TrackingAction.
+// Everything is packed into one 32-bit word, which is written as the
+// provenance column of the PhotonHits:
+//   bits 0-3   creator process (Process)
+//   bits 4-7   volume of the creation vertex (Volume)
+//   bits 8-15  geometry boundaries reached, saturating at 255
+// Millions of these are created per event, so they come from a thread-local
+// G4Allocator pool and do not carry the optional type string of the base
+class PhotonProvenance : public G4VUserTrackInformation {
+public:
+  enum Process : std::uint32_t {
+    kPrimary = 0, // shot by the generator
+    kCerenkov,
+    kScintillation,
+    kWLS,
+    kOtherProcess
+  };
+  enum Volume : std::uint32_t {
+    kOtherVolume = 0,
+    kAir, // World
+    kPET,
+    kOil,
+    kWindow,
+    kCathode,
+    kBackPlate
+  };
+
+  PhotonProvenance(Process process, Volume volume)
+      : fPacked(process | volume << kVolumeShift) {}
+
+  inline void *operator new(size_t);
+  inline void operator delete(void *info);
+
+  void AddBoundary() {
+    if (GetBoundaries(fPacked) < kMaxBoundaries)
+      fPacked += 1u << kBoundaryShift;
+  }
+  std::uint32_t GetPacked() const { return fPacked; }
+
+  void Print() const override;
+
+  //! Unpacking of the provenance column
+  static Process GetProcess(std::uint32_t packed) {
+    return Process(packed & 0xf);
+  }
+  static Volume GetVolume(std::uint32_t packed) {
+    return Volume(packed >> kVolumeShift & 0xf);
+  }
+  static std::uint32_t GetBoundaries(std::uint32_t packed) {
+    return packed >> kBoundaryShift & kMaxBoundaries;
+  }
+
+private:
+  static constexpr int kVolumeShift = 4;
+  static constexpr int kBoundaryShift = 8;
+  static constexpr std::uint32_t kMaxBoundaries = 0xff;
+
+  std::uint32_t fPacked;
+};
+
+//==============================================================================
+
+inline void *PhotonProvenance::operator new(size_t) {
+  if (!PhotonProvenanceAllocator)
+    PhotonProvenanceAllocator = new G4Allocator<PhotonProvenance>;
+  return PhotonProvenanceAllocator->MallocSingle();
+}
+
+//==============================================================================
+
+inline void PhotonProvenance::operator delete(void *info) {
+  PhotonProvenanceAllocator->FreeSingle(static_cast<PhotonProvenance *>(info));
+}
+
+#endif
@@ -0,0 +1,90 @@
+#include "PrimaryReplayFile.hh"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "globals.hh"
+
+namespace {
+constexpr char kMagic[8] = {'S', 'B', 'P', 'R', 'I', 'M', '0', '1'};
+constexpr std::size_t kHeaderSize = 24;
+} // namespace
+
+//==============================================================================
+
+PrimaryReplayFile::~PrimaryReplayFile() { Close(); }
+
+//==============================================================================
+
+bool PrimaryReplayFile::Open(const std::string &fileName) {
+  Close();
+  int fd = ::open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) {
+    G4cerr << "Error: Could not open " << fileName << G4endl;
+    return false;
+  }
+  struct stat info;
+  if (::fstat(fd, &info) != 0 ||
+      static_cast<std::size_t>(info.st_size) < kHeaderSize) {
+    G4cerr << "Error: " << fileName << " is not a primary replay file"
+           << G4endl;
+    ::close(fd);
+    return false;
+  }
+  fSize = info.st_size;
+  void *data = ::mmap(nullptr, fSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    G4cerr << "Error: Could not map " << fileName << G4endl;
+    fSize = 0;
+    return false;
+  }
+  fData = static_cast<const char *>(data);
+  // Start reading the whole file in the background
+  ::madvise(data, fSize, MADV_WILLNEED);
+
+  std::uint64_t nofEvents, nofPrimaries;
+  std::memcpy(&nofEvents, fData + 8, 8);
+  std::memcpy(&nofPrimaries, fData + 16, 8);
+  bool good = std::memcmp(fData, kMagic, sizeof(kMagic)) == 0 &&
+              nofEvents > 0 && nofEvents <= fSize / sizeof(Event) &&
+              nofPrimaries <= fSize / sizeof(Primary) &&
+              fSize == kHeaderSize + nofEvents * sizeof(Event) +
+                           nofPrimaries * sizeof(Primary);
+  if (good) {
+    fNofEvents = nofEvents;
+    fEvents = reinterpret_cast<const Event *>(fData + kHeaderSize);
+    fPrimaries = reinterpret_cast<const Primary *>(
+        fData + kHeaderSize + nofEvents * sizeof(Event));
+    // Checked once here, so the events can be used without checks
+    for (std::uint64_t i = 0; i < nofEvents && good; ++i) {
+      good = fEvents[i].firstPrimary <= nofPrimaries &&
+             fEvents[i].nofPrimaries <=
+                 nofPrimaries - fEvents[i].firstPrimary;
+    }
+  }
+  if (!good) {
+    G4cerr << "Error: " << fileName << " is not a valid primary replay file"
+           << G4endl;
+    Close();
+    return false;
+  }
+  return true;
+}
+
+//==============================================================================
+
+void PrimaryReplayFile::Close() {
+  if (fData)
+    ::munmap(const_cast<char *>(fData), fSize);
+  fData = nullptr;
+  fSize = 0;
+  fNofEvents = 0;
+  fEvents = nullptr;
+  fPrimaries = nullptr;
+}
+
+//==============================================================================
@@ -0,0 +1,65 @@
+#ifndef PRIMARY_REPLAY_FILE_HH
+#define PRIMARY_REPLAY_FILE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// The records are used in place, in the byte order of the host, which is
+// only the file layout on little endian hosts
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Primary replay files are only supported on little endian hosts"
+#endif
+
+// Pre-generated primaries for the replay source (.sprim). Layout, all
+// values little endian, every section 8 byte aligned:
+//
+//   "SBPRIM01"   8 byte magic
+//   uint64       number of events
+//   uint64       number of primaries
+//   Event[]      index of the first primary of every event and their number
+//   Primary[]    all primaries, in the order of the events
+//
+// The file is memory mapped and checked once when it is opened, so the
+// records are used in place without any parsing
+class PrimaryReplayFile {
+public:
+  struct Event {
+    std::uint64_t firstPrimary;
+    std::uint32_t nofPrimaries;
+    std::uint32_t reserved;
+  };
+  struct Primary {
+    std::int32_t pdgCode; // as known to the G4ParticleTable
+    std::uint32_t reserved;
+    double position[3];  // in mm
+    double direction[3]; // normalised
+    double kineticEnergy; // in MeV
+    double time;          // in ns
+  };
+  static_assert(sizeof(Event) == 16, "Event must match the file layout");
+  static_assert(sizeof(Primary) == 72, "Primary must match the file layout");
+
+  PrimaryReplayFile() = default;
+  ~PrimaryReplayFile();
+  PrimaryReplayFile(const PrimaryReplayFile &) = delete;
+  PrimaryReplayFile &operator=(const PrimaryReplayFile &) = delete;
+
+  bool Open(const std::string &fileName);
+  void Close();
+
+  std::uint64_t GetNofEvents() const { return fNofEvents; }
+  const Event &GetEvent(std::uint64_t index) const { return fEvents[index]; }
+  const Primary *GetPrimaries(const Event &event) const {
+    return fPrimaries + event.firstPrimary;
+  }
+
+private:
+  const char *fData = nullptr;
+  std::size_t fSize = 0;
+  std::uint64_t fNofEvents = 0;
+  const Event *fEvents = nullptr;
+  const Primary *fPrimaries = nullptr;
+};
+
+#endif
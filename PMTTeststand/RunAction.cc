@@ -1,13 +1,74 @@
 #include "RunAction.hh"
+#include "ColumnarHitSink.hh"
+#include "CsvHitSink.hh"
+#include "HitWriter.hh"
+#include "OutputMerger.hh"
+#include "generator.hh"
+
+#include "G4AccumulableManager.hh"
+#include "G4LogicalVolume.hh"
+#include "G4PhysicalVolumeStore.hh"
 #include "G4SystemOfUnits.hh"
+#include "G4Threading.hh"
+#include "G4Timer.hh"
+#include "G4VSolid.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 
 RunAction::RunAction(std::string outputName) : fOutputName(outputName) {
-  G4AnalysisManager *man = G4AnalysisManager::Instance();
+  DefineCommands();
+  // Created up front, so /analysis/h1/set and /analysis/h2/set work before
+  // the first run. They are only activated in the runs that fill them
+  CreateHistograms();
+  // Every thread registers the same accumulables, they are merged by index
+  auto accumulableManager = G4AccumulableManager::Instance();
+  accumulableManager->RegisterAccumulable(&fPhotonsPerEvent);
+  accumulableManager->RegisterAccumulable(&fDetectedEvents);
+  accumulableManager->RegisterAccumulable(&fPMTHits);
+  accumulableManager->RegisterAccumulable(&fSortTime);
+  accumulableManager->RegisterAccumulable(&fSortedHits);
+  accumulableManager->RegisterAccumulable(&fInjectedPhotons);
+  accumulableManager->RegisterAccumulable(&fRejectedSurfacePoints);
+  accumulableManager->RegisterAccumulable(&fDetectedWeight);
+  accumulableManager->RegisterAccumulable(&fDetectedWeight2);
+}
+
+//==============================================================================
+
+RunAction::~RunAction() {}
+
+//==============================================================================
+
+void RunAction::CreateNtuples() {
+  // The column types depend on the encoding, so the ntuples are created at
+  // the first run. Geant4 can not redefine them afterwards
+  auto man = G4GenericAnalysisManager::Instance();
   man->CreateNtuple("PhotonHits", "PhotonHits");
   man->CreateNtupleIColumn("evtID");
   man->CreateNtupleIColumn("det_uid"); // In case there are multiple PMTs
-  man->CreateNtupleDColumn("wavelength_in_nm");
-  man->CreateNtupleDColumn("time_in_ns");
+  switch (fEncoding.wavelength) {
+  case HitEncoding::Wavelength::Double:
+    man->CreateNtupleDColumn(fEncoding.WavelengthColumn());
+    break;
+  case HitEncoding::Wavelength::Float:
+    man->CreateNtupleFColumn(fEncoding.WavelengthColumn());
+    break;
+  case HitEncoding::Wavelength::Fixed:
+    man->CreateNtupleIColumn(fEncoding.WavelengthColumn());
+    break;
+  }
+  if (fEncoding.time == HitEncoding::Time::Double)
+    man->CreateNtupleDColumn(fEncoding.TimeColumn());
+  else
+    man->CreateNtupleFColumn(fEncoding.TimeColumn());
+  if (fEncoding.weight && fEncoding.trackWeight)
+    man->CreateNtupleFColumn("weight");
+  else if (fEncoding.weight)
+    man->CreateNtupleIColumn("weight");
+  if (fEncoding.provenance)
+    man->CreateNtupleIColumn("provenance");
   man->FinishNtuple(0);
 
   man->CreateNtuple("TotalHits", "TotalHits");
@@ -15,16 +76,38 @@ RunAction::RunAction(std::string outputName) : fOutputName(outputName) {
   man->CreateNtupleIColumn("det_uid"); // In case there are multiple PMTs
   man->CreateNtupleIColumn("TotalHits");
   man->FinishNtuple(1);
+
+  fNtuplesCreated = true;
+  fNtupleEncoding = fEncoding;
 }
 
 //==============================================================================
 
-RunAction::~RunAction() {}
+void RunAction::CreateHistograms() {
+  // Binning in nm and ns, as the hits are buffered
+  auto man = G4GenericAnalysisManager::Instance();
+  man->CreateH1("PhotonsPerEvent", "Detected photons per event", 100, 0.,
+                1000.);
+  man->CreateH1("Wavelength", "Wavelength of detected photons [nm]", 300,
+                200., 800.);
+  man->CreateH1("ArrivalTime", "Arrival time of detected photons [ns]", 200,
+                0., 200.);
+  man->CreateH2("WavelengthVsTime",
+                "Wavelength [nm] versus arrival time [ns]", 100, 0., 200., 60,
+                200., 800.);
+  // Hit positions in the frame of PMT_phys, the cathode has a radius of
+  // 127 mm and its apex points in -z
+  man->CreateH2("CathodeXY", "Cathode hits, y versus x [mm]", 130, -130.,
+                130., 130, -130., 130.);
+  man->CreateH2("CathodeThetaPhi",
+                "Cathode hits, angle to the PMT axis versus phi [deg]", 72,
+                -180., 180., 45, 0., 90.);
+}
 
 //==============================================================================
 
 void RunAction::BeginOfRunAction(const G4Run *run) {
-  G4AnalysisManager *man = G4AnalysisManager::Instance();
+  auto man = G4GenericAnalysisManager::Instance();
 
   // Use dynamic output name. If no extension specified default to .root
   G4int runID = run->GetRunID();
@@ -38,21 +121,381 @@ void RunAction::BeginOfRunAction(const G4Run *run) {
   if (pos == std::string::npos) {
     G4cout << "Warning: No file extension found. Defaulting to .root" << G4endl;
   }
-  std::string dynamicOutputName = baseName + strRunID.str() + extension;
+  fBaseName = baseName + strRunID.str();
+  fExtension = extension;
+  fEncoding.weight = fPhotonThinning > 1 || fTrackWeights;
+  fEncoding.trackWeight = fTrackWeights;
+  fEncoding.provenance = fPhotonProvenance;
+
+  static const std::vector<std::string> supportedExtensions = {
+      ".root", ".csv", ".hdf5", ".xml", ".scol"};
+  if (std::find(supportedExtensions.begin(), supportedExtensions.end(),
+                fExtension) == supportedExtensions.end()) {
+    G4String message = "Output extension " + fExtension +
+                       " is not supported. Use .root, .csv, .hdf5, .xml or "
+                       ".scol";
+    G4Exception("RunAction::BeginOfRunAction()", "Custom Code",
+                FatalException, message);
+  }
+
+  G4AccumulableManager::Instance()->Reset();
+  fRunCathodeHitMap = false;
+
+  // Geometry sweeps only need the statistics, skip the output entirely
+  if (fStatisticsOnly) {
+    fUseHitWriter = false;
+    return;
+  }
+
+  if (fHistogramsOnly && fExtension == ".scol") {
+    G4Exception("RunAction::BeginOfRunAction()", "Custom Code",
+                FatalException,
+                "Histograms can not be written to .scol files. Use .root, "
+                ".csv, .hdf5 or .xml");
+  }
+
+  // The async writer replaces the analysis manager output. It writes one
+  // file for all threads, so there is nothing to merge. The native columnar
+  // format is always written by the async writer
+  bool columnar = fExtension == ".scol";
+  fUseHitWriter =
+      !fHistogramsOnly && (columnar || (fAsyncWriter && fExtension == ".csv"));
+  if (fAsyncWriter && !fUseHitWriter) {
+    G4cout << "Warning: The async writer does not support " << fExtension
+           << " output. Using the analysis manager instead." << G4endl;
+  }
+  if (!fUseHitWriter && (fMaxFileSize > 0 || fMaxEventsPerFile > 0)) {
+    G4cout << "Warning: Output file rotation needs the async writer (.csv "
+              "with /Sandbox/Output/AsyncWriter or .scol). Writing one file."
+           << G4endl;
+  }
+  if (fUseHitWriter && fCathodeHitMap) {
+    G4cout << "Warning: The cathode hit maps are written by the analysis "
+              "manager and are not available with the async writer or .scol "
+              "output."
+           << G4endl;
+  }
+  if (fUseHitWriter) {
+    fRunEncoding = fEncoding;
+    if (IsMaster()) {
+      std::unique_ptr<HitSink> sink;
+      if (columnar) {
+        sink = std::make_unique<ColumnarHitSink>(
+            fColumnBlockRows, fCompressionLevel, fRunEncoding);
+      } else {
+        sink = std::make_unique<CsvHitSink>(fCsvBufferSize, fRunEncoding);
+      }
+      auto maxBytes = static_cast<std::uint64_t>(fMaxFileSize * 1024 * 1024);
+      // The worker threads would fall back to an analysis manager without
+      // an open file and lose every hit
+      if (!HitWriter::Instance().Open(std::move(sink), fBaseName, maxBytes,
+                                      fMaxEventsPerFile)) {
+        G4String message = "Could not open the output " + fBaseName +
+                           fExtension + " for the async writer";
+        G4Exception("RunAction::BeginOfRunAction()", "Custom Code",
+                    FatalException, message);
+      }
+    }
+    return;
+  }
+
+  // Per-thread buffering and merging of the ntuples. Geant4 only merges ROOT
+  // ntuples during the run, csv files are merged after the run by the master
+  // (see EndOfRunAction). HDF5 uses the basket size as chunk size
+  man->SetBasketSize(fExtension == ".hdf5" ? fChunkSize : fBasketSize);
+  man->SetBasketEntries(fBasketEntries);
+  man->SetCompressionLevel(fCompressionLevel);
+  if (fMergeNtuples && fExtension == ".root") {
+    man->SetNtupleMerging(true, fNofReducedFiles);
+    man->SetNtupleRowWise(fRowWise);
+  }
+
+  // Histograms are merged into the master in MT mode for every format
+  fRunCathodeHitMap = fCathodeHitMap;
+  if (!fHistogramsOnly) {
+    if (!fNtuplesCreated) {
+      CreateNtuples();
+    } else if (fEncoding != fNtupleEncoding) {
+      G4cout << "Warning: The column encoding, the photon thinning and the "
+                "provenance column of the ntuples can only be changed before "
+                "the first run. Keeping the previous ones."
+             << G4endl;
+    }
+  }
+  fRunEncoding = fNtupleEncoding;
+
+  // Inactive objects are neither filled nor written
+  man->SetActivation(true);
+  man->SetNtupleActivation(!fHistogramsOnly);
+  man->SetH1Activation(fHistogramsOnly);
+  man->SetH2Activation(kWavelengthVsTime, fHistogramsOnly);
+  man->SetH2Activation(kCathodeXY, fRunCathodeHitMap);
+  man->SetH2Activation(kCathodeThetaPhi, fRunCathodeHitMap);
+
+  std::string dynamicOutputName = fBaseName + fExtension;
   man->OpenFile(dynamicOutputName);
 }
 
 //==============================================================================
 
 void RunAction::EndOfRunAction(const G4Run *run) {
-  // retrieve the number of events produced in the run
-  G4int nofEvents = run->GetNumberOfEvent();
-  if (nofEvents == 0)
+  // The workers merge into the master, which ends the run last
+  G4AccumulableManager::Instance()->Merge();
+  if (IsMaster() && fSortedHits.GetValue() > 0) {
+    G4cout << "Output: sorting " << fSortedHits.GetValue()
+           << " photon hits took " << fSortTime.GetValue()
+           << " s (summed over all threads)" << G4endl;
+  }
+  if (IsMaster() && fInjectedPhotons.GetValue() > 0) {
+    const auto surface = GetSurfaceAcceptance();
+    G4cout << "Surface source: " << fInjectedPhotons.GetValue()
+           << " photons on " << surface.area << " cm2, acceptance "
+           << surface.acceptance << " +- " << surface.error
+           << ", effective area for isotropic light " << surface.effectiveArea
+           << " cm2" << G4endl;
+  }
+
+  if (fStatisticsOnly) {
+    if (IsMaster())
+      WriteStatistics(run);
     return;
-  G4AnalysisManager *man = G4AnalysisManager::Instance();
+  }
 
+  if (fUseHitWriter) {
+    // The master finishes the run after all workers, so every block is queued
+    if (IsMaster())
+      HitWriter::Instance().Close();
+    return;
+  }
+
+  // Always close the file, even if this thread did not process any events
+  // (which happens in tasking mode with more threads than tasks). Otherwise
+  // the file is left open and the next run can not open its output
+  auto man = G4GenericAnalysisManager::Instance();
+
+  G4Timer closeTimer;
+  closeTimer.Start();
   man->Write();
   man->CloseFile();
+  closeTimer.Stop();
+
+  if (!IsMaster() || !G4Threading::IsMultithreadedApplication())
+    return;
+
+  // All workers have closed their files at this point. With ROOT merging the
+  // master has written the merged ntuples in Write()/CloseFile() above
+  G4cout << "Output: writing and closing " << fBaseName + fExtension
+         << " took " << closeTimer.GetRealElapsed() << " s" << G4endl;
+
+  if (fMergeNtuples && fExtension == ".csv" && !fHistogramsOnly) {
+    G4Timer mergeTimer;
+    mergeTimer.Start();
+    int nofFiles = OutputMerger::MergeThreadCsvFiles(
+        fBaseName, {"PhotonHits", "TotalHits"});
+    mergeTimer.Stop();
+    G4cout << "Output: merging " << nofFiles << " per-thread files took "
+           << mergeTimer.GetRealElapsed() << " s" << G4endl;
+  }
+}
+
+//==============================================================================
+
+void RunAction::WriteStatistics(const G4Run *run) const {
+  const std::int64_t nofEvents = fPhotonsPerEvent.GetCount();
+  const std::int64_t nofDetected = fDetectedEvents.GetValue();
+  const double efficiency =
+      nofEvents > 0 ? double(nofDetected) / nofEvents : 0.;
+  const double efficiencyError =
+      nofEvents > 0 ? std::sqrt(efficiency * (1. - efficiency) / nofEvents)
+                    : 0.;
+  const double variance = fPhotonsPerEvent.GetVariance();
+  const double meanError = nofEvents > 0 ? std::sqrt(variance / nofEvents) : 0.;
+
+  G4cout << "Statistics of run " << run->GetRunID() << ": " << nofEvents
+         << " events, detection efficiency " << efficiency << " +- "
+         << efficiencyError << ", photons per event "
+         << fPhotonsPerEvent.GetMean() << " +- " << meanError
+         << " (variance " << variance << ")" << G4endl;
+
+  std::string fileName = fBaseName + "_summary.json";
+  std::ofstream out(fileName);
+  if (!out) {
+    G4cerr << "Error: Could not open " << fileName << G4endl;
+    return;
+  }
+  out.precision(10);
+  out << "{\n"
+      << "  \"run\": " << run->GetRunID() << ",\n"
+      << "  \"events\": " << nofEvents << ",\n"
+      << "  \"detected_events\": " << nofDetected << ",\n"
+      << "  \"detection_efficiency\": " << efficiency << ",\n"
+      << "  \"detection_efficiency_error\": " << efficiencyError << ",\n"
+      << "  \"photons_per_event\": {\"mean\": " << fPhotonsPerEvent.GetMean()
+      << ", \"variance\": " << variance << ", \"mean_error\": " << meanError
+      << "},\n"
+      << "  \"pmts\": [";
+  // Hit fraction: fraction of the events in which the PMT detected light
+  const auto &hitEvents = fPMTHits.GetHitEvents();
+  const auto &photons = fPMTHits.GetPhotons();
+  bool first = true;
+  for (size_t copyNr = 0; copyNr < hitEvents.size(); ++copyNr) {
+    if (hitEvents[copyNr] == 0)
+      continue;
+    out << (first ? "\n" : ",\n") << "    {\"copy_nr\": " << copyNr
+        << ", \"hit_events\": " << hitEvents[copyNr]
+        << ", \"hit_fraction\": " << double(hitEvents[copyNr]) / nofEvents
+        << ", \"photons\": " << photons[copyNr] << "}";
+    first = false;
+  }
+  out << (first ? "]" : "\n  ]");
+  if (fInjectedPhotons.GetValue() > 0) {
+    const auto surface = GetSurfaceAcceptance();
+    out << ",\n  \"surface_source\": {\"injected_photons\": "
+        << fInjectedPhotons.GetValue() << ", \"area_cm2\": " << surface.area
+        << ", \"acceptance\": " << surface.acceptance
+        << ", \"acceptance_error\": " << surface.error
+        << ", \"effective_area_cm2\": " << surface.effectiveArea << "}";
+  }
+  out << "\n}\n";
+  G4cout << "Statistics written to " << fileName << G4endl;
+}
+
+//==============================================================================
+
+RunAction::SurfaceAcceptance RunAction::GetSurfaceAcceptance() const {
+  // The surface points covered by other volumes are rejected by the
+  // generator, they do not count to the area
+  SurfaceAcceptance result{};
+  const auto volume = G4PhysicalVolumeStore::GetInstance()->GetVolume(
+      MyPrimaryGenerator::kSurfaceVolume, false);
+  const double injected = fInjectedPhotons.GetValue();
+  if (volume) {
+    const double sampled = injected + fRejectedSurfacePoints.GetValue();
+    result.area = volume->GetLogicalVolume()->GetSolid()->GetSurfaceArea() /
+                  cm2 * injected / sampled;
+  }
+  result.acceptance = fDetectedWeight.GetValue() / injected;
+  // Standard error of the weighted mean, sqrt(p (1 - p) / N) for unit
+  // weights
+  const double variance = std::max(
+      fDetectedWeight2.GetValue() / injected -
+          result.acceptance * result.acceptance,
+      0.);
+  result.error = std::sqrt(variance / injected);
+  // Isotropic light of fluence F crosses a convex surface of area A
+  // F A / 4 times
+  result.effectiveArea = result.area * result.acceptance / 4.;
+  return result;
+}
+
+//==============================================================================
+
+void RunAction::DefineCommands() {
+  fGenericMessenger = std::make_unique<G4GenericMessenger>(
+      this, "/Sandbox/Output/", "Control of the output");
+
+  fGenericMessenger
+      ->DeclareMethod("WavelengthEncoding", &RunAction::SetWavelengthEncoding)
+      .SetGuidance("Precision of the photon wavelength: double, float or "
+                   "fixed (integer with 0.1 nm resolution)")
+      .SetParameterName("encoding", false)
+      .SetCandidates("double float fixed")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareMethod("TimeEncoding", &RunAction::SetTimeEncoding)
+      .SetGuidance("Precision of the photon time: double, float or delta "
+                   "(float time since the previous hit of the event)")
+      .SetParameterName("encoding", false)
+      .SetCandidates("double float delta")
+      .SetStates(G4State_PreInit, G4State_Idle);
+
+  fGenericMessenger->DeclareProperty("PhotonThinning", fPhotonThinning)
+      .SetGuidance("Keep a random 1 in k of the photon hits, each with a "
+                   "weight column of k (1 = keep all). TotalHits still "
+                   "counts every photon")
+      .SetParameterName("k", false)
+      .SetRange("k > 0")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("TrackWeights", fTrackWeights)
+      .SetGuidance("Write the weight column as a float of the thinning times "
+                   "the track weight, e.g. the acceptance weight of the "
+                   "surface source")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("PhotonProvenance", fPhotonProvenance)
+      .SetGuidance("Write the creator process, creation volume and number of "
+                   "boundaries of every photon hit as one packed int column "
+                   "provenance (see PhotonProvenance.hh)")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("HistogramsOnly", fHistogramsOnly)
+      .SetGuidance("Fill histograms of the photons per event, wavelength, "
+                   "arrival time and wavelength versus time instead of "
+                   "writing the hits row by row")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("StatisticsOnly", fStatisticsOnly)
+      .SetGuidance("Only keep the detection efficiency, photons per event and "
+                   "hit fraction per PMT, and write them to "
+                   "<output>_summary.json. No output file is written")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("CathodeHitMap", fCathodeHitMap)
+      .SetGuidance("Fill maps of the photon hit positions on the cathode "
+                   "(x/y and theta/phi in the PMT frame)")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("AsyncWriter", fAsyncWriter)
+      .SetGuidance("Write the hits from a dedicated writer thread, so the "
+                   "simulation threads never wait for the disk (.csv only)")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("CsvBufferSize", fCsvBufferSize)
+      .SetGuidance("Size in bytes of each csv buffer of the async writer. "
+                   "Every full buffer is written with one system call")
+      .SetParameterName("size", false)
+      .SetRange("size > 0")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("MergeNtuples", fMergeNtuples)
+      .SetGuidance("Merge the per-thread ntuples into one file in MT mode. "
+                   "ROOT ntuples are merged during the run, csv files are "
+                   "merged in parallel after the run")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("RowWise", fRowWise)
+      .SetGuidance("ROOT merging: send complete rows to the master instead "
+                   "of column baskets")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("BasketSize", fBasketSize)
+      .SetGuidance("Per-thread ntuple buffer (basket) size in bytes")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("BasketEntries", fBasketEntries)
+      .SetGuidance("Number of rows per basket for column-wise ROOT merging")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("NofReducedNtupleFiles", fNofReducedFiles)
+      .SetGuidance("ROOT merging: write the merged ntuples in parallel into "
+                   "this many files (0 = one file)")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("ColumnBlockRows", fColumnBlockRows)
+      .SetGuidance("Number of rows per compressed block in .scol output")
+      .SetParameterName("rows", false)
+      .SetRange("rows > 0")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("ChunkSize", fChunkSize)
+      .SetGuidance("Chunk size of the HDF5 datasets")
+      .SetParameterName("size", false)
+      .SetRange("size > 0")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("CompressionLevel", fCompressionLevel)
+      .SetGuidance("Compression level of the .root, .hdf5 and .scol output "
+                   "(0 = uncompressed)")
+      .SetParameterName("level", false)
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("MaxFileSize", fMaxFileSize)
+      .SetGuidance("Start a new output file (<name>_part<N>) once the current "
+                   "one reaches this size in MB (0 = unlimited, async writer "
+                   "only)")
+      .SetParameterName("size", false)
+      .SetRange("size >= 0")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("MaxEventsPerFile", fMaxEventsPerFile)
+      .SetGuidance("Start a new output file (<name>_part<N>) after this many "
+                   "events with hits (0 = unlimited, async writer only)")
+      .SetParameterName("events", false)
+      .SetRange("events >= 0")
+      .SetStates(G4State_PreInit, G4State_Idle);
 }
 
 //==============================================================================
@@ -1,11 +1,16 @@
 #ifndef RUNACTION_HH
 #define RUNACTION_HH
 
-#include "G4AnalysisManager.hh"
+#include "G4Accumulable.hh"
+#include "G4GenericAnalysisManager.hh"
+#include "G4GenericMessenger.hh"
 #include "G4ParticleDefinition.hh"
 #include "G4Run.hh"
 #include "G4UserRunAction.hh"
 
+#include "HitEncoding.hh"
+#include "StatisticsAccumulables.hh"
+
 class RunAction : public G4UserRunAction {
 public:
   //! constructor
@@ -18,8 +23,91 @@ public:
   void BeginOfRunAction(const G4Run *);
   void EndOfRunAction(const G4Run *);
 
+  //! Precision of the PhotonHits columns in the current run
+  const HitEncoding &GetHitEncoding() const { return fRunEncoding; }
+  //! Keep 1 in k photon hits in the current run, 1 = keep all
+  int GetPhotonThinning() const {
+    return fRunEncoding.weight ? fPhotonThinning : 1;
+  }
+  //! The weight column of the current run includes the track weight
+  bool GetTrackWeights() const { return fRunEncoding.trackWeight; }
+  //! Tag the optical photons and write the provenance column in this run
+  bool GetPhotonProvenance() const {
+    return fRunEncoding.provenance && !fHistogramsOnly && !fStatisticsOnly;
+  }
+  //! Only fill the histograms, no rows are written
+  bool GetHistogramsOnly() const { return fHistogramsOnly; }
+  //! Fill the cathode hit maps in the current run
+  bool GetCathodeHitMap() const { return fRunCathodeHitMap; }
+  //! Only keep the run statistics, no output file is written
+  bool GetStatisticsOnly() const { return fStatisticsOnly; }
+
+  // Histogram IDs, the binning can be changed with /analysis/h1/set and
+  // /analysis/h2/set
+  enum H1 { kPhotonsPerEvent = 0, kWavelength, kArrivalTime };
+  enum H2 { kWavelengthVsTime = 0, kCathodeXY, kCathodeThetaPhi };
+
 private:
+  void DefineCommands();
+  void CreateNtuples();
+  void CreateHistograms();
+  void WriteStatistics(const G4Run *run) const;
+  struct SurfaceAcceptance {
+    double area;          // of the surface the photons start on, in cm2
+    double acceptance;    // weighted fraction of detected photons
+    double error;
+    double effectiveArea; // for isotropic light, in cm2
+  };
+  SurfaceAcceptance GetSurfaceAcceptance() const;
+  void SetWavelengthEncoding(G4String name) { fEncoding.SetWavelength(name); }
+  void SetTimeEncoding(G4String name) { fEncoding.SetTime(name); }
+
   std::string fOutputName;
+  std::string fBaseName;  // output name of the current run without extension
+  std::string fExtension; // extension of the current run's output
+
+  bool fNtuplesCreated = false;
+  HitEncoding fEncoding;    // as configured by the macro commands
+  HitEncoding fNtupleEncoding; // the ntuples were created with
+  HitEncoding fRunEncoding;    // used in the current run
+
+  std::unique_ptr<G4GenericMessenger> fGenericMessenger;
+  int fPhotonThinning = 1;       // keep 1 in k photon hits
+  bool fTrackWeights = false;     // float weight column with the track weight
+  bool fPhotonProvenance = false; // write the packed photon provenance
+  bool fHistogramsOnly = false; // fill histograms instead of writing rows
+  bool fStatisticsOnly = false; // only keep the accumulables below
+  bool fCathodeHitMap = false;    // fill the cathode hit position maps
+  bool fRunCathodeHitMap = false; // the hit maps are filled in this run
+
+  // Filled by the OpticalDetector through the G4AccumulableManager
+  WelfordAccumulable fPhotonsPerEvent{"PhotonsPerEvent"};
+  G4Accumulable<std::int64_t> fDetectedEvents{"DetectedEvents", 0};
+  PMTHitAccumulable fPMTHits{"PMTHits"};
+  G4Accumulable<G4double> fSortTime{"SortTime", 0.}; // in s, all threads
+  G4Accumulable<std::int64_t> fSortedHits{"SortedHits", 0};
+  // Surface source of the generator: injected primaries and their summed
+  // weights (and squares) of the detected photons
+  G4Accumulable<std::int64_t> fInjectedPhotons{"InjectedPhotons", 0};
+  G4Accumulable<std::int64_t> fRejectedSurfacePoints{"RejectedSurfacePoints",
+                                                     0};
+  G4Accumulable<G4double> fDetectedWeight{"DetectedWeight", 0.};
+  G4Accumulable<G4double> fDetectedWeight2{"DetectedWeight2", 0.};
+
+  bool fAsyncWriter = false;  // write the hits from a dedicated thread
+  bool fUseHitWriter = false; // the HitWriter is used for the current run
+  int fCsvBufferSize = 4 << 20; // async writer: bytes per csv buffer
+  bool fMergeNtuples = true;  // merge the per-thread output in MT mode
+  bool fRowWise = true;       // ROOT: merge complete rows instead of baskets
+  int fBasketSize = 32000;    // ROOT: per-thread basket size in bytes
+  int fBasketEntries = 4000;  // ROOT: rows per basket for column-wise merging
+  int fNofReducedFiles = 0;   // ROOT: > 0 merges into this many files in
+                              // parallel instead of one
+  int fChunkSize = 32000;       // HDF5: chunk size of the datasets
+  int fColumnBlockRows = 65536; // .scol: rows per compressed block
+  int fCompressionLevel = 3;    // 0 = no compression
+  G4double fMaxFileSize = 0;    // async writer: MB per file, 0 = unlimited
+  G4int fMaxEventsPerFile = 0;  // async writer: events per file, 0 = no limit
 };
 
 #endif
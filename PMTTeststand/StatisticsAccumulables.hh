@@ -0,0 +1,93 @@
+#ifndef STATISTICS_ACCUMULABLES_HH
+#define STATISTICS_ACCUMULABLES_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "G4VAccumulable.hh"
+
+// Online mean and variance (Welford). Threads are merged with the parallel
+// formula of Chan et al., so the result does not depend on the split of the
+// events between the threads
+class WelfordAccumulable : public G4VAccumulable {
+public:
+  explicit WelfordAccumulable(const G4String &name) : G4VAccumulable(name) {}
+
+  void Fill(double value) {
+    fCount++;
+    double delta = value - fMean;
+    fMean += delta / fCount;
+    fM2 += delta * (value - fMean);
+  }
+
+  void Merge(const G4VAccumulable &other) override {
+    const auto &rhs = static_cast<const WelfordAccumulable &>(other);
+    if (rhs.fCount == 0)
+      return;
+    std::int64_t count = fCount + rhs.fCount;
+    double delta = rhs.fMean - fMean;
+    fMean += delta * rhs.fCount / count;
+    fM2 += rhs.fM2 + delta * delta * fCount * rhs.fCount / count;
+    fCount = count;
+  }
+
+  void Reset() override {
+    fCount = 0;
+    fMean = 0.;
+    fM2 = 0.;
+  }
+
+  std::int64_t GetCount() const { return fCount; }
+  double GetMean() const { return fMean; }
+  //! Sample variance
+  double GetVariance() const { return fCount > 1 ? fM2 / (fCount - 1) : 0.; }
+
+private:
+  std::int64_t fCount = 0;
+  double fMean = 0.;
+  double fM2 = 0.; // sum of the squared deviations from the mean
+};
+
+//==============================================================================
+
+// Number of events with hits and number of photons per PMT copy number
+class PMTHitAccumulable : public G4VAccumulable {
+public:
+  explicit PMTHitAccumulable(const G4String &name) : G4VAccumulable(name) {}
+
+  void Fill(int copyNr, std::int64_t nofPhotons) {
+    if (static_cast<std::size_t>(copyNr) >= fHitEvents.size()) {
+      fHitEvents.resize(copyNr + 1, 0);
+      fPhotons.resize(copyNr + 1, 0);
+    }
+    fHitEvents[copyNr]++;
+    fPhotons[copyNr] += nofPhotons;
+  }
+
+  void Merge(const G4VAccumulable &other) override {
+    const auto &rhs = static_cast<const PMTHitAccumulable &>(other);
+    std::size_t size = std::max(fHitEvents.size(), rhs.fHitEvents.size());
+    fHitEvents.resize(size, 0);
+    fPhotons.resize(size, 0);
+    for (std::size_t i = 0; i < rhs.fHitEvents.size(); ++i) {
+      fHitEvents[i] += rhs.fHitEvents[i];
+      fPhotons[i] += rhs.fPhotons[i];
+    }
+  }
+
+  void Reset() override {
+    fHitEvents.clear();
+    fPhotons.clear();
+  }
+
+  //! Indexed by copy number
+  const std::vector<std::int64_t> &GetHitEvents() const { return fHitEvents; }
+  const std::vector<std::int64_t> &GetPhotons() const { return fPhotons; }
+
+private:
+  std::vector<std::int64_t> fHitEvents;
+  std::vector<std::int64_t> fPhotons;
+};
+
+#endif
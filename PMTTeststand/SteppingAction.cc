@@ -1,5 +1,6 @@
 #include "SteppingAction.hh"
 #include "EventAction.hh"
+#include "PhotonProvenance.hh"
 #include "RunAction.hh"
 
 #include "G4Geantino.hh"
@@ -10,6 +11,13 @@ SteppingAction::SteppingAction(RunAction *runAction, EventAction *EventAction)
 
 //==============================================================================
 
-void SteppingAction::UserSteppingAction(const G4Step *aStep) {}
+void SteppingAction::UserSteppingAction(const G4Step *aStep) {
+  // Only optical photons carry user information, see TrackingAction
+  if (aStep->GetPostStepPoint()->GetStepStatus() != fGeomBoundary)
+    return;
+  auto info = aStep->GetTrack()->GetUserInformation();
+  if (info)
+    static_cast<PhotonProvenance *>(info)->AddBoundary();
+}
 
 //==============================================================================
@@ -0,0 +1,90 @@
+#include "TrackingAction.hh"
+#include "RunAction.hh"
+
+#include "G4LogicalVolume.hh"
+#include "G4OpticalPhoton.hh"
+#include "G4RunManager.hh"
+#include "G4Track.hh"
+#include "G4TrackingManager.hh"
+#include "G4VProcess.hh"
+
+#include <algorithm>
+
+TrackingAction::TrackingAction(RunAction *runAction)
+    : fRunAction(runAction),
+      fOpticalPhoton(G4OpticalPhoton::OpticalPhotonDefinition()) {}
+
+//==============================================================================
+
+void TrackingAction::PreUserTrackingAction(const G4Track *track) {
+  if (track->GetDefinition() != fOpticalPhoton ||
+      !fRunAction->GetPhotonProvenance())
+    return;
+
+  // The tracking manager owns the information and deletes it with the track
+  fpTrackingManager->SetUserTrackInformation(
+      new PhotonProvenance(ClassifyProcess(track->GetCreatorProcess()),
+                           ClassifyVolume(track->GetLogicalVolumeAtVertex())));
+}
+
+//==============================================================================
+
+PhotonProvenance::Process
+TrackingAction::ClassifyProcess(const G4VProcess *process) {
+  if (!process)
+    return PhotonProvenance::kPrimary;
+  auto cached = std::find_if(
+      fProcesses.begin(), fProcesses.end(),
+      [process](const auto &entry) { return entry.first == process; });
+  if (cached != fProcesses.end())
+    return cached->second;
+
+  const auto &name = process->GetProcessName();
+  auto type = PhotonProvenance::kOtherProcess;
+  if (name == "Cerenkov")
+    type = PhotonProvenance::kCerenkov;
+  else if (name == "Scintillation")
+    type = PhotonProvenance::kScintillation;
+  else if (name == "OpWLS" || name == "OpWLS2")
+    type = PhotonProvenance::kWLS;
+  fProcesses.emplace_back(process, type);
+  return type;
+}
+
+//==============================================================================
+
+PhotonProvenance::Volume
+TrackingAction::ClassifyVolume(const G4LogicalVolume *volume) {
+  if (!volume)
+    return PhotonProvenance::kOtherVolume;
+  const auto run = G4RunManager::GetRunManager()->GetCurrentRun();
+  if (run && run->GetRunID() != fVolumesRunID) {
+    fVolumes.clear();
+    fVolumesRunID = run->GetRunID();
+  }
+  auto cached = std::find_if(
+      fVolumes.begin(), fVolumes.end(),
+      [volume](const auto &entry) { return entry.first == volume; });
+  if (cached != fVolumes.end())
+    return cached->second;
+
+  // Names of the logical volumes in DetectorConstruction
+  const auto &name = volume->GetName();
+  auto type = PhotonProvenance::kOtherVolume;
+  if (name == "World_log")
+    type = PhotonProvenance::kAir;
+  else if (name == "PMTPET_log")
+    type = PhotonProvenance::kPET;
+  else if (name == "PMTOil_log")
+    type = PhotonProvenance::kOil;
+  else if (name == "PMTWindow_log")
+    type = PhotonProvenance::kWindow;
+  else if (name == "PMT_log")
+    type = PhotonProvenance::kCathode;
+  else if (name == "BackPlate_log")
+    type = PhotonProvenance::kBackPlate;
+  fVolumes.emplace_back(volume, type);
+  return type;
+}
+
+//==============================================================================
@@ -0,0 +1,41 @@
+#ifndef TRACKINGACTION_HH
+#define TRACKINGACTION_HH
+
+#include <G4UserTrackingAction.hh>
+#include <utility>
+#include <vector>
+
+#include "PhotonProvenance.hh"
+
+class G4LogicalVolume;
+class G4ParticleDefinition;
+class G4VProcess;
+class RunAction;
+
+// Tags every optical photon with its PhotonProvenance if the provenance
+// column is written
+class TrackingAction : public G4UserTrackingAction {
+public:
+  //! constructor
+  TrackingAction(RunAction *);
+
+  void PreUserTrackingAction(const G4Track *) override;
+
+private:
+  PhotonProvenance::Process ClassifyProcess(const G4VProcess *process);
+  PhotonProvenance::Volume ClassifyVolume(const G4LogicalVolume *volume);
+
+  RunAction *fRunAction;
+  const G4ParticleDefinition *fOpticalPhoton;
+
+  // A handful of processes and volumes, so a linear search beats comparing
+  // their names for every photon. The volumes are dropped when the geometry
+  // may have changed
+  std::vector<std::pair<const G4VProcess *, PhotonProvenance::Process>>
+      fProcesses;
+  std::vector<std::pair<const G4LogicalVolume *, PhotonProvenance::Volume>>
+      fVolumes;
+  int fVolumesRunID = -1;
+};
+
+#endif
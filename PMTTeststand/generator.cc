@@ -1,23 +1,486 @@
 #include "generator.hh"
 
-MyPrimaryGenerator::MyPrimaryGenerator() {
-  // Ready both guns
-  fParticleGun = new G4ParticleGun(1);
-  fParticleSource = new G4GeneralParticleSource();
+#include "G4AccumulableManager.hh"
+#include "G4Event.hh"
+#include "G4Geantino.hh"
+#include "G4MuonMinus.hh"
+#include "G4MuonPlus.hh"
+#include "G4OpticalPhoton.hh"
+#include "G4PhysicalVolumeStore.hh"
+#include "G4ParticleTable.hh"
+#include "G4PhysicalConstants.hh"
+#include "G4PrimaryParticle.hh"
+#include "G4PrimaryVertex.hh"
+#include "G4RunManager.hh"
+#include "G4TransportationManager.hh"
+#include "Randomize.hh"
+
+#include "RunAction.hh"
+
+#include <algorithm>
+#include <cmath>
+
+MyPrimaryGenerator::MyPrimaryGenerator()
+    : fParticle(G4Geantino::Geantino()), fMuonPlus(G4MuonPlus::MuonPlus()),
+      fMuonMinus(G4MuonMinus::MuonMinus()),
+      fOpticalPhoton(G4OpticalPhoton::OpticalPhotonDefinition()) {
+  DefineCommands();
 }
 
 //==============================================================================
 
-MyPrimaryGenerator::~MyPrimaryGenerator() {
-  delete fParticleGun;
-  delete fParticleSource;
-}
+MyPrimaryGenerator::~MyPrimaryGenerator() {}
 
 //==============================================================================
 
 void MyPrimaryGenerator::GeneratePrimaries(G4Event *anEvent) {
-  // Currently GPS selected
-  fParticleSource->GeneratePrimaryVertex(anEvent);
+  if (fSource == Source::Replay) {
+    ReplayPrimaries(anEvent);
+    return;
+  }
+
+  if (fSource == Source::Cosmic) {
+    const G4ParticleDefinition *definition;
+    G4double energy;
+    G4ThreeVector position, direction;
+    SampleCosmicMuon(definition, energy, position, direction);
+    auto vertex = new G4PrimaryVertex(position, 0.);
+    auto particle = new G4PrimaryParticle(definition);
+    particle->SetKineticEnergy(energy);
+    particle->SetMomentumDirection(direction);
+    vertex->SetPrimary(particle);
+    anEvent->AddPrimaryVertex(vertex);
+    return;
+  }
+
+  // Vertices and particles come from the Geant4 allocator pools. A point
+  // source puts the whole burst into one vertex
+  G4PrimaryVertex *vertex = nullptr;
+  for (G4int i = 0; i < fBurstSize; ++i) {
+    G4ThreeVector direction;
+    G4double weight = 1.;
+    if (fSource == Source::Surface) {
+      G4ThreeVector position;
+      SampleSurfacePoint(position, direction, weight);
+      vertex = new G4PrimaryVertex(position, 0.);
+      anEvent->AddPrimaryVertex(vertex);
+    } else {
+      if (!vertex || fSphereSurface) {
+        vertex = new G4PrimaryVertex(SamplePosition(), 0.);
+        anEvent->AddPrimaryVertex(vertex);
+      }
+      direction = SampleDirection();
+    }
+    auto particle = new G4PrimaryParticle(fParticle);
+    particle->SetKineticEnergy(fEnergy);
+    particle->SetMomentumDirection(direction);
+    // Passed on to the track, see G4Track::GetWeight()
+    particle->SetWeight(weight);
+    if (fParticle == fOpticalPhoton)
+      particle->SetPolarization(SamplePolarization(direction));
+    vertex->SetPrimary(particle);
+  }
+  if (fSource == Source::Surface)
+    *fInjectedPhotons += fBurstSize;
+}
+
+//==============================================================================
+
+G4ThreeVector MyPrimaryGenerator::SamplePosition() const {
+  if (!fSphereSurface)
+    return fPosition;
+  const G4double cos_theta = 2. * G4UniformRand() - 1.;
+  const G4double sin_theta = std::sqrt(1. - cos_theta * cos_theta);
+  const G4double phi = twopi * G4UniformRand();
+  return fPosition + fRadius * G4ThreeVector(sin_theta * std::cos(phi),
+                                             sin_theta * std::sin(phi),
+                                             cos_theta);
+}
+
+//==============================================================================
+
+G4ThreeVector MyPrimaryGenerator::SampleDirection() const {
+  if (!fIsotropic)
+    return fDirection.unit();
+  // Uniform in cos(theta), the direction points against the sampled vector
+  // like /gps/ang/type iso
+  const G4double cos_min = std::cos(fMinTheta);
+  const G4double cos_max = std::cos(fMaxTheta);
+  const G4double cos_theta = cos_min - G4UniformRand() * (cos_min - cos_max);
+  const G4double sin_theta = std::sqrt(1. - cos_theta * cos_theta);
+  const G4double phi = twopi * G4UniformRand();
+  return -G4ThreeVector(sin_theta * std::cos(phi), sin_theta * std::sin(phi),
+                        cos_theta);
+}
+
+//==============================================================================
+
+G4double MyPrimaryGenerator::CosmicMuonFlux(G4double energy,
+                                            G4double cos_theta) {
+  // Gaisser's sea-level parameterisation, extended to low energies and large
+  // zenith angles by Guan et al. (arXiv:1509.06176). Energy in GeV, the
+  // normalisation does not matter for sampling
+  const G4double p1 = 0.102573, p2 = -0.068287, p3 = 0.958633,
+                 p4 = 0.0407253, p5 = 0.817285;
+  const G4double cos_star =
+      std::sqrt((cos_theta * cos_theta + p1 * p1 +
+                 p2 * std::pow(cos_theta, p3) + p4 * std::pow(cos_theta, p5)) /
+                (1. + p1 * p1 + p2 + p4));
+  const G4double e_cos = 1.1 * energy * cos_star;
+  return 0.14 *
+         std::pow(energy * (1. + 3.64 / (energy * std::pow(cos_star, 1.29))),
+                  -2.7) *
+         (1. / (1. + e_cos / 115.) + 0.054 / (1. + e_cos / 850.));
+}
+
+//==============================================================================
+
+void MyPrimaryGenerator::BuildCosmicTable() {
+  if (fCosmicMaxEnergy <= fCosmicMinEnergy) {
+    G4Exception("MyPrimaryGenerator::BuildCosmicTable()", "Custom Code",
+                FatalException,
+                "CosmicMaxEnergy has to be larger than CosmicMinEnergy");
+  }
+  // Every bin is weighted with its flux times its width in E and cos(theta).
+  // The flux through the sphere does not depend on the direction, so there
+  // is no additional cos(theta) factor
+  const G4double log_min = std::log(fCosmicMinEnergy / GeV);
+  const G4double d_log = (std::log(fCosmicMaxEnergy / GeV) - log_min) /
+                         kEnergyBins;
+  std::vector<double> weights(kCosThetaBins * kEnergyBins);
+  for (int i = 0; i < kCosThetaBins; ++i) {
+    const G4double cos_theta = (i + 0.5) / kCosThetaBins;
+    for (int j = 0; j < kEnergyBins; ++j) {
+      const G4double energy = std::exp(log_min + (j + 0.5) * d_log);
+      weights[i * kEnergyBins + j] =
+          CosmicMuonFlux(energy, cos_theta) * energy * d_log;
+    }
+  }
+  fCosmicTable.Build(weights);
+  fTableMinEnergy = fCosmicMinEnergy;
+  fTableMaxEnergy = fCosmicMaxEnergy;
+}
+
+//==============================================================================
+
+void MyPrimaryGenerator::SampleCosmicMuon(
+    const G4ParticleDefinition *&particle, G4double &energy,
+    G4ThreeVector &position, G4ThreeVector &direction) {
+  if (fCosmicMinEnergy != fTableMinEnergy ||
+      fCosmicMaxEnergy != fTableMaxEnergy)
+    BuildCosmicTable();
+
+  // Uniform within the bin, log-uniform in energy
+  const auto bin = fCosmicTable.Sample(G4UniformRand());
+  const G4double cos_theta =
+      (bin / kEnergyBins + G4UniformRand()) / kCosThetaBins;
+  const G4double log_min = std::log(fCosmicMinEnergy);
+  const G4double d_log =
+      (std::log(fCosmicMaxEnergy) - log_min) / kEnergyBins;
+  const G4double total_energy =
+      std::exp(log_min + (bin % kEnergyBins + G4UniformRand()) * d_log);
+
+  // Sea-level charge ratio mu+/mu- of about 1.27
+  particle = G4UniformRand() < 1.27 / 2.27 ? fMuonPlus : fMuonMinus;
+  energy = std::max(total_energy - particle->GetPDGMass(), 0.);
+
+  // Downwards from the zenith angle theta around +z
+  const G4double sin_theta = std::sqrt(1. - cos_theta * cos_theta);
+  const G4double phi = twopi * G4UniformRand();
+  direction = -G4ThreeVector(sin_theta * std::cos(phi),
+                             sin_theta * std::sin(phi), cos_theta);
+
+  // Uniform on the disk of Radius through the centre that faces the muon,
+  // so every direction sees the same cross section. The start point is moved
+  // back along the track onto the sphere, which keeps it inside the world
+  const G4ThreeVector u = direction.orthogonal().unit();
+  const G4ThreeVector v = direction.cross(u);
+  const G4double r = fRadius * std::sqrt(G4UniformRand());
+  const G4double alpha = twopi * G4UniformRand();
+  position = fPosition + r * (std::cos(alpha) * u + std::sin(alpha) * v) -
+             std::sqrt(fRadius * fRadius - r * r) * direction;
+}
+
+//==============================================================================
+
+void MyPrimaryGenerator::SampleSurfacePoint(G4ThreeVector &position,
+                                            G4ThreeVector &direction,
+                                            G4double &weight) {
+  // The geometry may have been rebuilt between runs
+  const auto run = G4RunManager::GetRunManager()->GetCurrentRun();
+  if (!fSurfaceVolume || (run && run->GetRunID() != fSurfaceRunID)) {
+    fSurfaceVolume =
+        G4PhysicalVolumeStore::GetInstance()->GetVolume(kSurfaceVolume, false);
+    if (!fSurfaceVolume) {
+      G4Exception("MyPrimaryGenerator::SampleSurfacePoint()", "Custom Code",
+                  FatalException,
+                  "The volume of the surface source does not exist");
+    }
+    if (!fNavigator)
+      fNavigator = std::make_unique<G4Navigator>();
+    const auto world = G4TransportationManager::GetTransportationManager()
+                           ->GetNavigatorForTracking()
+                           ->GetWorldVolume();
+    fNavigator->SetWorldVolume(world);
+    if (fSurfaceVolume->GetMotherLogical() != world->GetLogicalVolume()) {
+      G4Exception("MyPrimaryGenerator::SampleSurfacePoint()", "Custom Code",
+                  FatalException,
+                  "The volume of the surface source has to be placed "
+                  "directly in the world");
+    }
+    fSurfaceRunID = run ? run->GetRunID() : -1;
+    auto acc_man = G4AccumulableManager::Instance();
+    fInjectedPhotons = acc_man->GetAccumulable<std::int64_t>("InjectedPhotons");
+    fRejectedSurfacePoints =
+        acc_man->GetAccumulable<std::int64_t>("RejectedSurfacePoints");
+
+    // The weights of iso incidence are lost in hit files without them
+    const auto run_action = static_cast<const RunAction *>(
+        G4RunManager::GetRunManager()->GetUserRunAction());
+    if (fIncidence == Incidence::Iso && run_action &&
+        !run_action->GetStatisticsOnly() && !run_action->GetHistogramsOnly() &&
+        !run_action->GetTrackWeights()) {
+      G4Exception("MyPrimaryGenerator::SampleSurfacePoint()", "Custom Code",
+                  JustWarning,
+                  "IncidenceType iso weights the photons, but the hits are "
+                  "written without the weights. Use "
+                  "/Sandbox/Output/TrackWeights true");
+    }
+  }
+
+  // Start 1 um outside, the rejected points give the covered area
+  constexpr G4double offset = 1. * um;
+  constexpr int max_tries = 1000;
+  const auto solid = fSurfaceVolume->GetLogicalVolume()->GetSolid();
+  const auto mother = fSurfaceVolume->GetMotherLogical();
+  // The placement in the mother is the global transform, because the volume
+  // sits directly in the world (checked above)
+  const auto rotation = fSurfaceVolume->GetObjectRotationValue();
+  const auto translation = fSurfaceVolume->GetObjectTranslation();
+  G4ThreeVector normal;
+  for (int tries = 0;; ++tries) {
+    if (tries == max_tries) {
+      G4Exception("MyPrimaryGenerator::SampleSurfacePoint()", "Custom Code",
+                  FatalException,
+                  "No sampled surface point lies in the mother volume");
+    }
+    const auto local = solid->GetPointOnSurface();
+    normal = rotation * solid->SurfaceNormal(local);
+    position = rotation * local + translation + offset * normal;
+    const auto volume =
+        fNavigator->LocateGlobalPointAndSetup(position, nullptr, false, true);
+    if (volume && volume->GetLogicalVolume() == mother)
+      break;
+    *fRejectedSurfacePoints += 1;
+  }
+
+  G4double cos_theta = 1.;
+  switch (fIncidence) {
+  case Incidence::Cosine:
+    cos_theta = std::sqrt(G4UniformRand());
+    break;
+  case Incidence::Iso:
+    cos_theta = G4UniformRand();
+    weight = 2. * cos_theta;
+    break;
+  case Incidence::Fixed:
+    cos_theta = std::cos(fIncidenceAngle);
+    break;
+  }
+  const G4double sin_theta = std::sqrt(1. - cos_theta * cos_theta);
+  const G4double phi = twopi * G4UniformRand();
+  const G4ThreeVector e1 = normal.orthogonal().unit();
+  const G4ThreeVector e2 = normal.cross(e1);
+  direction = -cos_theta * normal +
+              sin_theta * (std::cos(phi) * e1 + std::sin(phi) * e2);
+}
+
+//==============================================================================
+
+G4ThreeVector
+MyPrimaryGenerator::SamplePolarization(const G4ThreeVector &direction) {
+  // Random linear polarization perpendicular to the direction, as for
+  // unpolarized light
+  const G4ThreeVector e1 = direction.orthogonal().unit();
+  const G4ThreeVector e2 = direction.cross(e1);
+  const G4double angle = twopi * G4UniformRand();
+  return std::cos(angle) * e1 + std::sin(angle) * e2;
+}
+
+//==============================================================================
+
+void MyPrimaryGenerator::ReplayPrimaries(G4Event *anEvent) {
+  if (fReplayFileName != fOpenReplayFileName) {
+    if (!fReplayFile.Open(fReplayFileName)) {
+      G4String message = "Could not open the replay file " + fReplayFileName;
+      G4Exception("MyPrimaryGenerator::ReplayPrimaries()", "Custom Code",
+                  FatalException, message);
+    }
+    fOpenReplayFileName = fReplayFileName;
+    fReplayWrapped = false;
+  }
+
+  // Event IDs are unique within a run, so the threads read disjoint records
+  // without coordination. Every run starts again at the first record
+  std::uint64_t index = anEvent->GetEventID();
+  if (index >= fReplayFile.GetNofEvents()) {
+    if (!fReplayWrapped) {
+      G4Exception("MyPrimaryGenerator::ReplayPrimaries()", "Custom Code",
+                  JustWarning,
+                  "The run has more events than the replay file, its "
+                  "events are reused");
+      fReplayWrapped = true;
+    }
+    index %= fReplayFile.GetNofEvents();
+  }
+
+  const auto &event = fReplayFile.GetEvent(index);
+  const auto primaries = fReplayFile.GetPrimaries(event);
+  for (std::uint32_t i = 0; i < event.nofPrimaries; ++i) {
+    const auto &primary = primaries[i];
+    auto vertex = new G4PrimaryVertex(primary.position[0] * mm,
+                                      primary.position[1] * mm,
+                                      primary.position[2] * mm,
+                                      primary.time * ns);
+    auto particle =
+        new G4PrimaryParticle(GetReplayParticle(primary.pdgCode));
+    particle->SetKineticEnergy(primary.kineticEnergy * MeV);
+    particle->SetMomentumDirection(G4ThreeVector(
+        primary.direction[0], primary.direction[1], primary.direction[2]));
+    vertex->SetPrimary(particle);
+    anEvent->AddPrimaryVertex(vertex);
+  }
+}
+
+//==============================================================================
+
+const G4ParticleDefinition *
+MyPrimaryGenerator::GetReplayParticle(G4int pdg_code) {
+  // A replay file holds a handful of particle types
+  for (const auto &[code, particle] : fReplayParticles) {
+    if (code == pdg_code)
+      return particle;
+  }
+  auto particle = G4ParticleTable::GetParticleTable()->FindParticle(pdg_code);
+  if (!particle) {
+    G4String message =
+        "Unknown PDG code " + std::to_string(pdg_code) + " in the replay file";
+    G4Exception("MyPrimaryGenerator::GetReplayParticle()", "Custom Code",
+                FatalException, message);
+  }
+  fReplayParticles.emplace_back(pdg_code, particle);
+  return particle;
+}
+
+//==============================================================================
+
+void MyPrimaryGenerator::SetParticle(G4String name) {
+  auto particle = G4ParticleTable::GetParticleTable()->FindParticle(name);
+  if (!particle) {
+    G4String message = "Unknown particle " + name + ", keeping " +
+                       fParticle->GetParticleName();
+    G4Exception("MyPrimaryGenerator::SetParticle()", "Custom Code",
+                JustWarning, message);
+    return;
+  }
+  fParticle = particle;
+}
+
+//==============================================================================
+
+void MyPrimaryGenerator::DefineCommands() {
+  fGenericMessenger = std::make_unique<G4GenericMessenger>(
+      this, "/Sandbox/Gun/", "Control of the primary generator");
+
+  fGenericMessenger
+      ->DeclareMethod("SourceType", &MyPrimaryGenerator::SetSourceType)
+      .SetGuidance("gun: the particle gun below, surface: the particle gun "
+                   "started on the outer surface of the PMT capsule, cosmic: "
+                   "muons with the sea-level flux, crossing the sphere of "
+                   "Radius around Position, replay: primaries from "
+                   "ReplayFile")
+      .SetParameterName("type", false)
+      .SetCandidates("gun surface cosmic replay")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger
+      ->DeclarePropertyWithUnit("CosmicMinEnergy", "GeV", fCosmicMinEnergy)
+      .SetGuidance("Minimum total energy of the cosmic muons")
+      .SetParameterName("energy", false)
+      .SetRange("energy > 0.")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger
+      ->DeclarePropertyWithUnit("CosmicMaxEnergy", "GeV", fCosmicMaxEnergy)
+      .SetGuidance("Maximum total energy of the cosmic muons")
+      .SetParameterName("energy", false)
+      .SetRange("energy > 0.")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger
+      ->DeclareMethod("IncidenceType", &MyPrimaryGenerator::SetIncidenceType)
+      .SetGuidance("Angle to the inward normal of the surface source: cosine "
+                   "(isotropic light), iso (uniform in solid angle, weighted "
+                   "to isotropic light) or fixed (IncidenceAngle)")
+      .SetParameterName("type", false)
+      .SetCandidates("cosine iso fixed")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger
+      ->DeclarePropertyWithUnit("IncidenceAngle", "deg", fIncidenceAngle)
+      .SetGuidance("Angle to the inward normal for IncidenceType fixed")
+      .SetParameterName("angle", false)
+      .SetRange("angle >= 0. && angle < 90.")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("ReplayFile", fReplayFileName)
+      .SetGuidance("Binary file with the primaries of every event (.sprim, "
+                   "see PrimaryReplayFile.hh). Event i of every run replays "
+                   "record i")
+      .SetParameterName("file", false)
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareMethod("Particle", &MyPrimaryGenerator::SetParticle)
+      .SetGuidance("Name of the primary particle")
+      .SetParameterName("particle", false)
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("BurstSize", fBurstSize)
+      .SetGuidance("Number of primaries of the gun per event, each with its "
+                   "own position and direction. Optical photons in a burst "
+                   "are still detected one by one")
+      .SetParameterName("N", false)
+      .SetRange("N > 0")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclarePropertyWithUnit("Energy", "MeV", fEnergy)
+      .SetGuidance("Kinetic energy of the primary")
+      .SetParameterName("energy", false)
+      .SetRange("energy > 0.")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclarePropertyWithUnit("Position", "mm", fPosition)
+      .SetGuidance("Position of a point source, or the centre of the sphere")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger
+      ->DeclareMethod("PositionType", &MyPrimaryGenerator::SetPositionType)
+      .SetGuidance("point: at Position, sphere: uniform on the surface of a "
+                   "sphere of Radius around Position")
+      .SetParameterName("type", false)
+      .SetCandidates("point sphere")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclarePropertyWithUnit("Radius", "mm", fRadius)
+      .SetGuidance("Radius of the sphere")
+      .SetParameterName("radius", false)
+      .SetRange("radius >= 0.")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger
+      ->DeclareMethod("AngularType", &MyPrimaryGenerator::SetAngularType)
+      .SetGuidance("direction: along Direction, iso: isotropic between "
+                   "MinTheta and MaxTheta, where theta = 0 points in -z")
+      .SetParameterName("type", false)
+      .SetCandidates("direction iso")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclareProperty("Direction", fDirection)
+      .SetGuidance("Momentum direction, does not need to be normalised")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclarePropertyWithUnit("MinTheta", "deg", fMinTheta)
+      .SetGuidance("Minimum polar angle of isotropic directions")
+      .SetStates(G4State_PreInit, G4State_Idle);
+  fGenericMessenger->DeclarePropertyWithUnit("MaxTheta", "deg", fMaxTheta)
+      .SetGuidance("Maximum polar angle of isotropic directions")
+      .SetStates(G4State_PreInit, G4State_Idle);
 }
 
 //==============================================================================
@@ -3,11 +3,25 @@
 
 #include "G4VUserPrimaryGeneratorAction.hh"
 
-#include "G4GeneralParticleSource.hh"
-#include "G4ParticleGun.hh"
-#include "G4ParticleTable.hh"
+#include "G4Accumulable.hh"
+#include "G4GenericMessenger.hh"
+#include "G4Navigator.hh"
+#include "G4ParticleDefinition.hh"
 #include "G4SystemOfUnits.hh"
+#include "G4ThreeVector.hh"
 
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "AliasTable.hh"
+#include "PrimaryReplayFile.hh"
+
+// Source of the primaries, configured with /Sandbox/Gun/: a particle gun,
+// optionally started on the surface of the PMT capsule, cosmic muons with
+// the sea-level flux, or primaries replayed from a file.
+// Every worker thread owns its generator and samples with its own random
+// engine, so unlike the GPS no lock is taken per event
 class MyPrimaryGenerator : public G4VUserPrimaryGeneratorAction {
 public:
   MyPrimaryGenerator();
@@ -15,9 +29,98 @@ public:
 
   virtual void GeneratePrimaries(G4Event *);
 
+  //! Physical volume the surface source starts the primaries on
+  static constexpr const char *kSurfaceVolume = "PMTPET_phys";
+
 private:
-  G4ParticleGun *fParticleGun;
-  G4GeneralParticleSource *fParticleSource;
+  void DefineCommands();
+  void SetParticle(G4String name);
+  void SetPositionType(G4String type) { fSphereSurface = type == "sphere"; }
+  void SetAngularType(G4String type) { fIsotropic = type == "iso"; }
+  void SetSourceType(G4String type) {
+    fSource = type == "cosmic"    ? Source::Cosmic
+              : type == "replay"  ? Source::Replay
+              : type == "surface" ? Source::Surface
+                                  : Source::Gun;
+  }
+  void SetIncidenceType(G4String type) {
+    fIncidence = type == "iso"     ? Incidence::Iso
+                 : type == "fixed" ? Incidence::Fixed
+                                   : Incidence::Cosine;
+  }
+  G4ThreeVector SamplePosition() const;
+  G4ThreeVector SampleDirection() const;
+  static G4ThreeVector SamplePolarization(const G4ThreeVector &direction);
+  void SampleSurfacePoint(G4ThreeVector &position, G4ThreeVector &direction,
+                          G4double &weight);
+  void BuildCosmicTable();
+  void SampleCosmicMuon(const G4ParticleDefinition *&particle,
+                        G4double &energy, G4ThreeVector &position,
+                        G4ThreeVector &direction);
+  static G4double CosmicMuonFlux(G4double energy, G4double cos_theta);
+  void ReplayPrimaries(G4Event *event);
+  const G4ParticleDefinition *GetReplayParticle(G4int pdg_code);
+
+  std::unique_ptr<G4GenericMessenger> fGenericMessenger;
+  enum class Source { Gun, Cosmic, Replay, Surface };
+  Source fSource = Source::Gun;
+  const G4ParticleDefinition *fParticle;
+  G4double fEnergy = 1. * MeV;  // kinetic energy
+  G4ThreeVector fPosition;      // the point or the centre of the sphere
+  bool fSphereSurface = false;  // uniform on the surface of a sphere
+  G4double fRadius = 0.;        // of the sphere
+  bool fIsotropic = false;      // isotropic within the theta range
+  G4ThreeVector fDirection{0., 0., 1.}; // normalised when sampled
+  // Polar angle range of isotropic directions. As for the GPS, theta = 0
+  // points in -z
+  G4double fMinTheta = 0.;
+  G4double fMaxTheta = 180. * deg;
+  // Primaries per event. Bursts of optical photons share the event setup,
+  // which dominates the time of single photon scans
+  G4int fBurstSize = 1;
+
+  // Surface source: the primaries start just outside a point of the outer
+  // surface of kSurfaceVolume, sampled uniformly in area. Their angle to the
+  // inward normal follows the incidence distribution, and their weight
+  // corrects it to isotropic light
+  enum class Incidence {
+    Cosine, // as for isotropic light crossing the surface, weight 1
+    Iso,    // uniform in solid angle, weight 2 cos(theta)
+    Fixed   // at IncidenceAngle with random azimuth, weight 1
+  };
+  Incidence fIncidence = Incidence::Cosine;
+  G4double fIncidenceAngle = 0.;
+  const G4VPhysicalVolume *fSurfaceVolume = nullptr;
+  G4int fSurfaceRunID = -1;
+  // Checks that the start point is in the mother volume, e.g. not in the
+  // back plate. Separate from the tracking navigator
+  std::unique_ptr<G4Navigator> fNavigator;
+  // Owned by the RunAction of this thread
+  G4Accumulable<std::int64_t> *fInjectedPhotons = nullptr;
+  G4Accumulable<std::int64_t> *fRejectedSurfacePoints = nullptr;
+
+  // Cosmic muons cross the sphere of Radius around Position from all
+  // directions of the upper (+z) hemisphere
+  G4double fCosmicMinEnergy = 1. * GeV; // total energy
+  G4double fCosmicMaxEnergy = 10. * TeV;
+  // Joint distribution of cos(theta) and log(E) bins, rebuilt when the
+  // energy range changes
+  static constexpr int kCosThetaBins = 100;
+  static constexpr int kEnergyBins = 200;
+  AliasTable fCosmicTable;
+  G4double fTableMinEnergy = 0.;
+  G4double fTableMaxEnergy = 0.;
+  const G4ParticleDefinition *fMuonPlus;
+  const G4ParticleDefinition *fMuonMinus;
+  const G4ParticleDefinition *fOpticalPhoton;
+
+  // Replay source, mapped separately by every thread
+  G4String fReplayFileName;
+  G4String fOpenReplayFileName;
+  PrimaryReplayFile fReplayFile;
+  bool fReplayWrapped = false;
+  std::vector<std::pair<G4int, const G4ParticleDefinition *>>
+      fReplayParticles;
 };
 
 #endif
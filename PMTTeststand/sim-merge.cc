@@ -0,0 +1,78 @@
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "DatasetMerger.hh"
+
+#include "CLI11.hpp"
+
+int main(int argc, char **argv) {
+  CLI::App app{"Merges PMT Teststand output files into one dataset"};
+  std::vector<std::string> inputs;
+  std::string outputName = "merged.scol";
+  int nthreads = 0;
+  std::string wavelengthEncoding;
+  std::string timeEncoding;
+  int blockRows = 65536;
+  int compressionLevel = 3;
+  double maxMemory = 4096.;
+
+  app.add_option("inputs", inputs,
+                 "<.scol files, PhotonHits/TotalHits csv files or "
+                 "directories with such files>")
+      ->required();
+  app.add_option("-o, --output", outputName,
+                 "<Merged output, .csv or .scol> Default: 'merged.scol'");
+  app.add_option("-t, --nthreads", nthreads,
+                 "<number of threads reading the inputs, 0 = all cores> "
+                 "Default: 0");
+  app.add_option("--wavelength-encoding", wavelengthEncoding,
+                 "<double|float|fixed> Default: as the first input")
+      ->check(CLI::IsMember({"double", "float", "fixed"}));
+  app.add_option("--time-encoding", timeEncoding,
+                 "<double|float|delta> Default: as the first input")
+      ->check(CLI::IsMember({"double", "float", "delta"}));
+  app.add_option("--block-rows", blockRows,
+                 "<rows per compressed block of .scol output> Default: 65536")
+      ->check(CLI::PositiveNumber);
+  app.add_option("--compression-level", compressionLevel,
+                 "<zstd level of .scol output, 0 = uncompressed> Default: 3");
+  app.add_option("--max-memory", maxMemory,
+                 "<MB the inputs read ahead of the output may take> "
+                 "Default: 4096")
+      ->check(CLI::PositiveNumber);
+
+  CLI11_PARSE(app, argc, argv);
+
+  if (nthreads <= 0) {
+    nthreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  DatasetMerger merger(nthreads);
+  merger.SetMemoryLimit(static_cast<std::uint64_t>(maxMemory * 1024 * 1024));
+  if (!wavelengthEncoding.empty() || !timeEncoding.empty()) {
+    // Options that are not given keep the default precision
+    HitEncoding encoding;
+    if (!wavelengthEncoding.empty())
+      encoding.SetWavelength(wavelengthEncoding);
+    if (!timeEncoding.empty())
+      encoding.SetTime(timeEncoding);
+    merger.SetEncoding(encoding);
+  }
+  int nofDatasets = 0;
+  for (const auto &input : inputs) {
+    nofDatasets += merger.AddInput(input);
+  }
+  std::cout << "Merging " << nofDatasets << " dataset(s) with " << nthreads
+            << " threads" << std::endl;
+
+  auto start = std::chrono::steady_clock::now();
+  bool good = merger.Merge(outputName, blockRows, compressionLevel);
+  std::cout << "Merging took "
+            << std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                             start)
+                   .count()
+            << " s" << std::endl;
+
+  return good ? 0 : 1;
+}
@@ -1,9 +1,11 @@
 #include <iostream>
 
-#include "G4MTRunManager.hh"
 #include "G4OpticalParameters.hh"
 #include "G4OpticalPhysics.hh"
 #include "G4RunManager.hh"
+#include "G4RunManagerFactory.hh"
+#include "G4TaskRunManager.hh"
+#include "G4Threading.hh"
 #include "G4UIExecutive.hh"
 #include "G4UImanager.hh"
 #include "G4VisExecutive.hh"
@@ -18,47 +20,76 @@
 int main(int argc, char **argv) {
   CLI::App app{"PMT Teststand simulations"};
   int nthreads = 1;
+  int tasksPerThread = 16;
+  std::string runMode;
   std::string macroName;
   std::string outputName = "output.root";
 
   app.add_option("-m,--macro", macroName,
                  "<Geant4 macro filename> Default: None");
   app.add_option("-t, --nthreads", nthreads,
-                 "<number of threads to use> Default: 1");
+                 "<number of threads to use, 0 = all cores> Default: 1");
+  app.add_option("-r, --run-mode", runMode,
+                 "<serial|mt|tasking> Default: serial for 1 thread, mt "
+                 "otherwise")
+      ->check(CLI::IsMember({"serial", "mt", "tasking"}));
+  app.add_option("--tasks-per-thread", tasksPerThread,
+                 "<number of event tasks per thread in tasking mode> "
+                 "Default: 16")
+      ->check(CLI::PositiveNumber);
   app.add_option("-o, --output", outputName,
                  "<Output filename> Default: 'output.root'");
 
   CLI11_PARSE(app, argc, argv);
 
-  // Allow Multi-threading if available, although not tested
-  G4RunManager *runManager = nullptr;
+  if (nthreads <= 0) {
+    nthreads = G4Threading::G4GetNumberOfCores();
+  }
+  if (runMode.empty()) {
+    runMode = (nthreads > 1) ? "mt" : "serial";
+  }
 
-#ifdef G4MULTITHREADED
+#ifndef G4MULTITHREADED
+  if (runMode != "serial") {
+    G4cout << "Warning: Geant4 was built without multithreading support. "
+              "Falling back to serial mode."
+           << G4endl;
+    runMode = "serial";
+  }
+#endif
 
-  if (nthreads > 1) {
-    nthreads = std::min(
-        nthreads, G4Threading::G4GetNumberOfCores()); // limit thread number to
-                                                      // max on machine
+  G4RunManagerType runManagerType = G4RunManagerType::Serial;
+  if (runMode == "mt") {
+    runManagerType = G4RunManagerType::MT;
+  } else if (runMode == "tasking") {
+    runManagerType = G4RunManagerType::Tasking;
+  }
+  if (runManagerType != G4RunManagerType::Serial &&
+      nthreads > G4Threading::G4GetNumberOfCores()) {
+    G4cout << "Warning: " << nthreads << " threads requested, but only "
+           << G4Threading::G4GetNumberOfCores()
+           << " cores are available on this machine." << G4endl;
+  }
 
-    runManager = new G4MTRunManager();
-    G4cout << "      ********* Run Manager constructed in MT mode: " << nthreads
-           << " threads ***** " << G4endl;
-    G4cout << "      ********* WARNING: MT Compatibility is not tested! ***** "
-           << G4endl;
-    runManager->SetNumberOfThreads(nthreads);
-  } else {
-    runManager = new G4RunManager();
+  G4RunManager *runManager =
+      G4RunManagerFactory::CreateRunManager(runManagerType, nthreads);
+
+  if (runManagerType == G4RunManagerType::Serial) {
     G4cout << "      ********** Run Manager constructed in sequential mode "
               "************ "
            << G4endl;
-  }
-
-#else
-  runManager = new G4RunManager();
-  G4cout << "      ********** Run Manager constructed in sequential mode "
-            "************ "
-         << G4endl;
+  } else {
+#ifdef G4MULTITHREADED
+    // Tasking mode: split every run into many small event tasks, so idle
+    // threads can steal work from busy ones instead of waiting on the slowest
+    // thread at the end of the run
+    if (auto taskRunManager = dynamic_cast<G4TaskRunManager *>(runManager)) {
+      taskRunManager->SetGrainsize(nthreads * tasksPerThread);
+    }
 #endif
+    G4cout << "      ********* Run Manager constructed in " << runMode
+           << " mode: " << nthreads << " threads ***** " << G4endl;
+  }
 
   /* Initialize all custom implemented stuff*/
   runManager->SetUserInitialization(new DetectorConstruction());
@@ -92,5 +123,11 @@ int main(int argc, char **argv) {
     UImanager->ApplyCommand(command + macroName);
   }
 
+  // Deleting the run manager terminates the worker threads, which makes sure
+  // every thread has closed its output
+  delete ui;
+  delete visManager;
+  delete runManager;
+
   return 0;
 }